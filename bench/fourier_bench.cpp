@@ -0,0 +1,430 @@
+// Benchmarks for fourtd::fourier in the spirit of Google Benchmark: every case is repeated
+// until it has run for --min_time seconds, then reported per iteration.
+//
+//   fourier_bench [--filter=<regex>] [--format=console|json|csv] [--out=<file>]
+//                 [--min_time=<seconds>] [--max_n=<samples>]
+//
+// Each case stops at its own largest N, below --max_n for the O(N^2) ones; --help lists them.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trinterp.hpp"
+#include "sliding_fourier.hpp"
+#include "fourier_batch.hpp"
+#include "fixed_fourier.hpp"
+
+using namespace fourtd;
+
+namespace
+{
+	struct result
+	{
+		std::string name;
+		size_t iterations;
+		double real_ns;
+		double cpu_ns;
+	};
+
+	struct options
+	{
+		std::regex filter{ ".*" };
+		std::string format = "console";
+		std::string out;
+		double min_time = 0.5;
+		size_t max_n = 1000000;
+	};
+
+	// closed contour with a few harmonics and some noise, like a scanned outline
+	std::vector<complex_double> contour(size_t n)
+	{
+		std::mt19937 rng(static_cast<unsigned>(n));
+		std::uniform_real_distribution<double> noise(-1.0, 1.0);
+		std::vector<complex_double> pts(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const auto t = 2 * pi * static_cast<double>(i) / static_cast<double>(n);
+			pts[i] = std::polar(200.0, t) + std::polar(40.0, 5 * t) + std::polar(10.0, -11 * t) + complex_double(noise(rng), noise(rng));
+		}
+		return pts;
+	}
+
+	// runs body in growing batches until min_time has passed
+	result measure(const std::string& name, double min_time, const std::function<void()>& body)
+	{
+		size_t batch = 1;
+		size_t iterations = 0;
+		double real = 0.0;
+		std::clock_t cpu = 0;
+		while (real < min_time)
+		{
+			const auto c0 = std::clock();
+			const auto t0 = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < batch; ++i)
+				body();
+			const auto t1 = std::chrono::steady_clock::now();
+			cpu += std::clock() - c0;
+			real += std::chrono::duration<double>(t1 - t0).count();
+			iterations += batch;
+			batch *= 2;
+		}
+		return { name, iterations, real * 1e9 / iterations, static_cast<double>(cpu) / CLOCKS_PER_SEC * 1e9 / iterations };
+	}
+
+	struct benchmark
+	{
+		const char* name;
+		// largest N the case is run at; evaluation-bound cases grow as N^2
+		size_t max_n;
+		std::function<std::function<void()>(size_t)> setup;
+	};
+
+	// n outlines of 128 samples each, for the batch cases
+	std::shared_ptr<std::vector<std::vector<complex_double>>> outlines(size_t n)
+	{
+		auto result = std::make_shared<std::vector<std::vector<complex_double>>>(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			(*result)[i] = contour(128);
+			for (auto& z : (*result)[i])
+				z *= 1.0 + static_cast<double>(i % 17) / 17;
+		}
+		return result;
+	}
+
+	// sum of f.nativ_value over n angles, so the calls cannot be dropped
+	template<class F> std::function<void()> value_loop(std::shared_ptr<const F> f, size_t n)
+	{
+		auto sink = std::make_shared<complex_double>();
+		return [f, n, sink]
+		{
+			complex_double sum;
+			for (size_t i = 0; i < n; ++i)
+				sum += f->nativ_value(2 * pi * static_cast<double>(i) / static_cast<double>(n));
+			*sink += sum;
+		};
+	}
+
+	template<class F> std::function<void()> derivative_loop(std::shared_ptr<const F> f, size_t n)
+	{
+		auto sink = std::make_shared<complex_double>();
+		return [f, n, sink]
+		{
+			complex_double sum;
+			for (size_t i = 0; i < n; ++i)
+				sum += f->nativ_derivative_value(std::polar(1.0, 2 * pi * static_cast<double>(i) / static_cast<double>(n)));
+			*sink += sum;
+		};
+	}
+
+	std::vector<benchmark> benchmarks()
+	{
+		return
+		{
+			{ "calcul_coeff", 1000000, [](size_t n)
+				{
+					auto pts = std::make_shared<std::vector<complex_double>>(contour(n));
+					auto f = std::make_shared<fourier>(pts->cbegin(), pts->cend());
+					return [pts, f] { f->calcul_coeff(pts->cbegin(), pts->cend()); };
+				}
+			},
+			{ "calcul_coeff_m64", 1000000, [](size_t n)
+				{
+					auto pts = std::make_shared<std::vector<complex_double>>(contour(n));
+					auto f = std::make_shared<fourier>(pts->cbegin(), pts->cend());
+					return [pts, f] { f->calcul_coeff(pts->cbegin(), pts->cend(), 64); };
+				}
+			},
+			{ "calcul_coeff_direct", 10000, [](size_t n)
+				{
+					auto pts = std::make_shared<std::vector<complex_double>>(contour(n));
+					auto f = std::make_shared<fourier>(pts->cbegin(), pts->cend());
+					return [pts, f] { f->calcul_coeff_direct(pts->cbegin(), pts->cend()); };
+				}
+			},
+			{ "values", 1000, [](size_t n)
+				{
+					const auto pts = contour(n);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend());
+					auto out = std::make_shared<std::vector<complex_double>>();
+					return [f, out, n]
+					{
+						out->clear();
+						f->values<complex_double>(std::back_inserter(*out), 0, static_cast<double>(n), 0.01);
+					};
+				}
+			},
+			// the same outline as values, within a quarter unit of the curve
+			{ "tessellate", 1000, [](size_t n)
+				{
+					const auto pts = contour(n);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend());
+					auto out = std::make_shared<std::vector<complex_double>>();
+					return [f, out, n]
+					{
+						out->clear();
+						f->tessellate<complex_double>(std::back_inserter(*out), 0, static_cast<double>(n), 0.25);
+					};
+				}
+			},
+			{ "length", 1000, [](size_t n)
+				{
+					const auto pts = contour(n);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend());
+					return [f, n] { f->length(0, static_cast<double>(n), 0.0, 1e-6); };
+				}
+			},
+			// square() caches its result, so it is timed behind the zero move that resets the cache;
+			// the difference to update_point is the O(M) area sum
+			{ "update_point", 1000000, [](size_t n)
+				{
+					const auto pts = contour(n);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend());
+					return [f] { f->update_point(0, {}, {}); };
+				}
+			},
+			{ "update_point_square", 1000000, [](size_t n)
+				{
+					const auto pts = contour(n);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend());
+					return [f] { f->update_point(0, {}, {}); f->square(); };
+				}
+			},
+			{ "lengthToPoint", 10000, [](size_t n)
+				{
+					const auto pts = contour(n);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend());
+					auto rng = std::make_shared<std::mt19937>(1);
+					f->lengthToPoint({});
+					return [f, rng]
+					{
+						std::uniform_real_distribution<double> d(-250.0, 250.0);
+						f->lengthToPoint({ d(*rng), d(*rng) });
+					};
+				}
+			},
+			{ "sliding_push", 100000, [](size_t n)
+				{
+					auto pts = std::make_shared<std::vector<complex_double>>(contour(n));
+					auto s = std::make_shared<sliding_fourier>(pts->cbegin(), pts->cend());
+					auto next = std::make_shared<size_t>(0);
+					return [pts, s, next]
+					{
+						s->push((*pts)[*next]);
+						*next = (*next + 1) % pts->size();
+					};
+				}
+			},
+			{ "sliding_push_m64", 1000000, [](size_t n)
+				{
+					auto pts = std::make_shared<std::vector<complex_double>>(contour(n));
+					auto s = std::make_shared<sliding_fourier>(pts->cbegin(), pts->cend(), 64);
+					auto next = std::make_shared<size_t>(0);
+					return [pts, s, next]
+					{
+						s->push((*pts)[*next]);
+						*next = (*next + 1) % pts->size();
+					};
+				}
+			},
+			// N counts curves here
+			{ "batch_fit_128", 100000, [](size_t n)
+				{
+					auto curves = outlines(n);
+					auto b = std::make_shared<fourier_batch>(128, 32);
+					return [curves, b] { b->assign(curves->cbegin(), curves->cend()); };
+				}
+			},
+			{ "batch_lengths_128", 100000, [](size_t n)
+				{
+					const auto curves = outlines(n);
+					auto b = std::make_shared<fourier_batch>(128, 32);
+					b->assign(curves->cbegin(), curves->cend());
+					return [b] { b->lengths(0.0, 1e-6); };
+				}
+			},
+			{ "simpson", 1000, [](size_t n)
+				{
+					const auto pts = contour(n);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend());
+					return [f, n] { f->simpson(0.0, 2 * pi, 4 * n); };
+				}
+			},
+			// N counts evaluated angles here; the same 16 harmonics through the generic loop and
+			// through fixed_fourier<16>
+			{ "nativ_value_m16", 100000, [](size_t n)
+				{
+					const auto pts = contour(256);
+					return value_loop(std::make_shared<const fourier>(pts.cbegin(), pts.cend(), 16), n);
+				}
+			},
+			{ "fixed_nativ_value_16", 100000, [](size_t n)
+				{
+					const auto pts = contour(256);
+					return value_loop(std::make_shared<const fixed_fourier<16>>(pts.cbegin(), pts.cend()), n);
+				}
+			},
+			{ "nativ_derivative_value_m16", 100000, [](size_t n)
+				{
+					const auto pts = contour(256);
+					return derivative_loop(std::make_shared<const fourier>(pts.cbegin(), pts.cend(), 16), n);
+				}
+			},
+			{ "fixed_nativ_derivative_value_16", 100000, [](size_t n)
+				{
+					const auto pts = contour(256);
+					return derivative_loop(std::make_shared<const fixed_fourier<16>>(pts.cbegin(), pts.cend()), n);
+				}
+			},
+			{ "values_m16", 100000, [](size_t n)
+				{
+					const auto pts = contour(256);
+					auto f = std::make_shared<fourier>(pts.cbegin(), pts.cend(), 16);
+					auto out = std::make_shared<std::vector<complex_double>>();
+					return [f, out, n]
+					{
+						out->clear();
+						f->values<complex_double>(std::back_inserter(*out), 0, 256, 256.0 / static_cast<double>(n));
+					};
+				}
+			},
+			{ "fixed_values_16", 100000, [](size_t n)
+				{
+					const auto pts = contour(256);
+					auto f = std::make_shared<fixed_fourier<16>>(pts.cbegin(), pts.cend());
+					auto out = std::make_shared<std::vector<complex_double>>();
+					return [f, out, n]
+					{
+						out->clear();
+						f->values<complex_double>(std::back_inserter(*out), 0, 256, 256.0 / static_cast<double>(n));
+					};
+				}
+			},
+		};
+	}
+
+	void console_header(std::ostream& os)
+	{
+		char line[160];
+		std::snprintf(line, sizeof(line), "%-32s %16s %16s %12s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations");
+		os << line;
+	}
+
+	void console_row(std::ostream& os, const result& r)
+	{
+		char line[160];
+		std::snprintf(line, sizeof(line), "%-32s %16.0f %16.0f %12zu\n", r.name.c_str(), r.real_ns, r.cpu_ns, r.iterations);
+		os << line;
+	}
+
+	void report(std::ostream& os, const std::vector<result>& results, const std::string& format)
+	{
+		if (format == "json")
+		{
+			os << "{\n  \"context\": { \"num_cpus\": " << std::thread::hardware_concurrency() << " },\n  \"benchmarks\": [\n";
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const auto& r = results[i];
+				os << "    { \"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+					<< ", \"real_time\": " << r.real_ns << ", \"cpu_time\": " << r.cpu_ns << ", \"time_unit\": \"ns\" }"
+					<< (i + 1 < results.size() ? ",\n" : "\n");
+			}
+			os << "  ]\n}\n";
+		}
+		else if (format == "csv")
+		{
+			os << "name,iterations,real_time,cpu_time,time_unit\n";
+			for (const auto& r : results)
+				os << r.name << ',' << r.iterations << ',' << r.real_ns << ',' << r.cpu_ns << ",ns\n";
+		}
+		else
+		{
+			console_header(os);
+			for (const auto& r : results)
+				console_row(os, r);
+		}
+	}
+
+	bool parse(int argc, char* argv[], options& opt)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const auto eq = arg.find('=');
+			const auto key = arg.substr(0, eq);
+			const auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+			if (key == "--filter")
+				opt.filter = std::regex(value);
+			else if (key == "--format" && (value == "console" || value == "json" || value == "csv"))
+				opt.format = value;
+			else if (key == "--out")
+				opt.out = value;
+			else if (key == "--min_time")
+				opt.min_time = std::stod(value);
+			else if (key == "--max_n")
+				opt.max_n = std::stoul(value);
+			else
+			{
+				std::cerr << "usage: fourier_bench [--filter=<regex>] [--format=console|json|csv] [--out=<file>] [--min_time=<seconds>] [--max_n=<samples>]\n"
+					"every case runs at N = 10, 100, ... up to --max_n and its own limit:\n";
+				for (const auto& b : benchmarks())
+				{
+					char line[80];
+					std::snprintf(line, sizeof(line), "  %-32s N <= %zu\n", b.name, b.max_n);
+					std::cerr << line;
+				}
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	if (!parse(argc, argv, opt))
+		return 1;
+
+	// console output to the terminal is streamed row by row
+	const bool live = opt.format == "console" && opt.out.empty();
+	if (live)
+		console_header(std::cout);
+
+	std::vector<result> results;
+	for (const auto& b : benchmarks())
+	{
+		for (size_t n = 10; n <= std::min(b.max_n, opt.max_n); n *= 10)
+		{
+			const auto name = std::string(b.name) + "/" + std::to_string(n);
+			if (!std::regex_search(name, opt.filter))
+				continue;
+			results.push_back(measure(name, opt.min_time, b.setup(n)));
+			if (live)
+				console_row(std::cout, results.back());
+		}
+	}
+
+	if (!opt.out.empty())
+	{
+		std::ofstream file(opt.out);
+		report(file, results, opt.format);
+	}
+	else if (!live)
+	{
+		report(std::cout, results, opt.format);
+	}
+	return 0;
+}
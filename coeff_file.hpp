@@ -0,0 +1,532 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iterator>
+#include "trinterp.hpp"
+#include "fourier_batch.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Coefficient file, version 1. All integers are little-endian 64-bit unless noted, and every
+// section starts at a multiple of 64 bytes, so a mapped file can be evaluated in place.
+//
+//   header     magic "FOURTDCF", u32 version, u32 flags (bit 0: float32 harmonics),
+//              u32 byte-order mark 0x01020304, u32 reserved, curve count, directory offset
+//   directory  per curve: block offset, sample count N, harmonic count M, reserved
+//   block      a0 as two doubles, padded to 64 bytes, then ar[M], ai[M], br[M], bi[M],
+//              each padded to 64 bytes
+//
+// Harmonic k sits at index k-1; a full fit of an even N ends with the Nyquist term (0, bn).
+
+namespace fourtd
+{
+	namespace detail
+	{
+		inline constexpr char coeff_file_magic[8] = { 'F', 'O', 'U', 'R', 'T', 'D', 'C', 'F' };
+		inline constexpr uint32_t coeff_file_version = 1;
+		inline constexpr uint32_t coeff_file_float32 = 1;
+		inline constexpr uint32_t coeff_file_byte_order = 0x01020304;
+		inline constexpr uint64_t coeff_file_alignment = 64;
+
+		struct coeff_file_header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t flags;
+			uint32_t byte_order;
+			uint32_t reserved0;
+			uint64_t curve_count;
+			uint64_t directory_offset;
+			uint64_t reserved[3];
+		};
+		static_assert(sizeof(coeff_file_header) == 64, "coeff_file_header must stay 64 bytes");
+
+		struct coeff_file_entry
+		{
+			uint64_t offset;
+			uint64_t samples;
+			uint64_t harmonics;
+			uint64_t reserved;
+		};
+		static_assert(sizeof(coeff_file_entry) == 32, "coeff_file_entry must stay 32 bytes");
+
+		inline uint64_t align_up(uint64_t value) noexcept
+		{
+			return (value + coeff_file_alignment - 1) / coeff_file_alignment * coeff_file_alignment;
+		}
+
+		// bytes between the harmonic arrays of a block
+		inline uint64_t coeff_stride(uint64_t harmonics, bool single_precision) noexcept
+		{
+			return align_up(harmonics * (single_precision ? sizeof(float) : sizeof(double)));
+		}
+
+		inline uint64_t coeff_block_size(uint64_t harmonics, bool single_precision) noexcept
+		{
+			return coeff_file_alignment + 4 * coeff_stride(harmonics, single_precision);
+		}
+
+		inline coeff_file_header make_coeff_header(uint64_t curve_count, uint64_t directory_offset, bool single_precision) noexcept
+		{
+			coeff_file_header header{};
+			std::memcpy(header.magic, coeff_file_magic, sizeof(header.magic));
+			header.version = coeff_file_version;
+			header.flags = single_precision ? coeff_file_float32 : 0;
+			header.byte_order = coeff_file_byte_order;
+			header.curve_count = curve_count;
+			header.directory_offset = directory_offset;
+			return header;
+		}
+
+		template<class R, class Coeff> void fill_coeff_rows(unsigned char* block, const std::vector<Coeff>& ab, bool single_precision)
+		{
+			const auto stride = coeff_stride(ab.size(), single_precision);
+			for (size_t k = 0; k < ab.size(); ++k)
+			{
+				const R values[4] =
+				{
+					static_cast<R>(ab[k].first.real()), static_cast<R>(ab[k].first.imag()),
+					static_cast<R>(ab[k].second.real()), static_cast<R>(ab[k].second.imag())
+				};
+				for (size_t row = 0; row < 4; ++row)
+					std::memcpy(block + coeff_file_alignment + row * stride + k * sizeof(R), &values[row], sizeof(R));
+			}
+		}
+
+		// the block of one curve into bytes, which is resized and can be reused between curves
+		template<class Coeff> void make_coeff_block(std::vector<unsigned char>& bytes, const complex_double& a0, const std::vector<Coeff>& ab, bool single_precision)
+		{
+			bytes.assign(coeff_block_size(ab.size(), single_precision), 0);
+			const double a0_parts[2] = { a0.real(), a0.imag() };
+			std::memcpy(bytes.data(), a0_parts, sizeof(a0_parts));
+			if (single_precision)
+				fill_coeff_rows<float>(bytes.data(), ab, single_precision);
+			else
+				fill_coeff_rows<double>(bytes.data(), ab, single_precision);
+		}
+
+		// read-only mapping of a whole file
+		class mapped_file
+		{
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator =(const mapped_file&) = delete;
+
+		public:
+			explicit mapped_file(const std::string& path)
+			{
+#if defined(_WIN32)
+				file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (file == INVALID_HANDLE_VALUE) return;
+				LARGE_INTEGER file_size;
+				if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return;
+				mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (!mapping) return;
+				const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				if (!view) return;
+				bytes = static_cast<const unsigned char*>(view);
+				length = static_cast<size_t>(file_size.QuadPart);
+#else
+				const int fd = ::open(path.c_str(), O_RDONLY);
+				if (fd < 0) return;
+				struct stat st;
+				if (::fstat(fd, &st) == 0 && st.st_size > 0)
+				{
+					const auto view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+					if (view != MAP_FAILED)
+					{
+						bytes = static_cast<const unsigned char*>(view);
+						length = static_cast<size_t>(st.st_size);
+					}
+				}
+				::close(fd);
+#endif
+			}
+
+			~mapped_file()
+			{
+#if defined(_WIN32)
+				if (bytes) UnmapViewOfFile(bytes);
+				if (mapping) CloseHandle(mapping);
+				if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+				if (bytes) ::munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+			}
+
+			const unsigned char* data() const noexcept
+			{
+				return bytes;
+			}
+
+			size_t size() const noexcept
+			{
+				return length;
+			}
+
+		private:
+			const unsigned char* bytes = nullptr;
+			size_t length = 0;
+#if defined(_WIN32)
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#endif
+		};
+	}
+
+	// One curve of a coefficient file, read in place from the mapping: no copy, O(M) per point.
+	class curve_view
+	{
+	public:
+		using TrCoeff = fourier::TrCoeff;
+
+		size_t samples() const noexcept
+		{
+			return n;
+		}
+
+		size_t harmonics() const noexcept
+		{
+			return m;
+		}
+
+		bool single_precision() const noexcept
+		{
+			return is_float;
+		}
+
+		complex_double firstCoeff() const noexcept
+		{
+			double a0[2];
+			std::memcpy(a0, block, sizeof(a0));
+			return { a0[0], a0[1] };
+		}
+
+		// harmonic k + 1
+		TrCoeff coeff(size_t k) const noexcept
+		{
+			return is_float ? coeff_at<float>(k) : coeff_at<double>(k);
+		}
+
+		complex_double nativ_value(double angle) const noexcept
+		{
+			return is_float ? sum<float>(angle) : sum<double>(angle);
+		}
+
+		complex_double value(double idx) const noexcept
+		{
+			return nativ_value((1 + 2 * idx) * pi / static_cast<double>(n));
+		}
+
+		template<typename C, typename OutIt> void values(OutIt it, double a, double b, double delta = 0.01) const
+		{
+			if (n == 0) return;
+			const auto local_a = (1 + 2 * a) * pi / static_cast<double>(n);
+			const auto local_b = (1 + 2 * b) * pi / static_cast<double>(n);
+			const auto local_delta = 2 * delta * pi / static_cast<double>(n);
+
+			const auto total = fourier::sample_count(local_a, local_b, local_delta);
+			fourier::emit_values<C>(it, local_a, local_delta, total, [this](const double* angles, size_t count, complex_double* out)
+				{
+					for (size_t i = 0; i < count; ++i)
+						out[i] = nativ_value(angles[i]);
+				}
+			);
+		}
+
+		double square() const noexcept
+		{
+			double sum = 0.0;
+			for (size_t k = 0; k < m; ++k)
+			{
+				const auto c = coeff(k);
+				sum += c.first.real() * c.second.imag() - c.first.imag() * c.second.real();
+			}
+			return pi * std::abs(sum);
+		}
+
+	private:
+		friend class coeff_file;
+
+		template<class T> const T* row(size_t index) const noexcept
+		{
+			return reinterpret_cast<const T*>(block + detail::coeff_file_alignment + index * detail::coeff_stride(m, is_float));
+		}
+
+		template<class T> TrCoeff coeff_at(size_t k) const noexcept
+		{
+			return { { row<T>(0)[k], row<T>(1)[k] }, { row<T>(2)[k], row<T>(3)[k] } };
+		}
+
+		template<class T> complex_double sum(double angle) const noexcept
+		{
+			const T* ar = row<T>(0);
+			const T* ai = row<T>(1);
+			const T* br = row<T>(2);
+			const T* bi = row<T>(3);
+			double re = 0.0, im = 0.0;
+			fourier::TrigonometricIterator it(std::polar(1.0, angle), 0.0);
+			for (size_t k = 0; k < m; ++k, ++it)
+			{
+				const auto c = it.cos(), s = it.sin();
+				re += ar[k] * c + br[k] * s;
+				im += ai[k] * c + bi[k] * s;
+			}
+			return firstCoeff() + complex_double(re, im);
+		}
+
+		const unsigned char* block = nullptr;
+		size_t n = 0;
+		size_t m = 0;
+		bool is_float = false;
+	};
+
+	// Collects curves and writes them as one coefficient file.
+	class coeff_writer
+	{
+	public:
+		using TrCoeff = fourier::TrCoeff;
+
+		explicit coeff_writer(bool single_precision = false) :
+			is_float(single_precision)
+		{
+		}
+
+		template<class T> void add(const basic_fourier<T>& f)
+		{
+			std::vector<TrCoeff> ab;
+			ab.reserve(f.ab.size());
+			for (const auto& c : f.ab)
+				ab.emplace_back(complex_double(c.first), complex_double(c.second));
+			curves.push_back({ f.size, complex_double(f.a0), std::move(ab) });
+		}
+
+		void add(const fourier_batch& batch)
+		{
+			for (size_t i = 0; i < batch.size(); ++i)
+				curves.push_back({ batch.samples_per_curve(), batch.firstCoeff(i), batch.coeffs(i) });
+		}
+
+		size_t size() const noexcept
+		{
+			return curves.size();
+		}
+
+		bool save(const std::string& path) const
+		{
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			return out && write(out);
+		}
+
+		bool write(std::ostream& out) const
+		{
+			const auto header = detail::make_coeff_header(curves.size(), sizeof(detail::coeff_file_header), is_float);
+
+			std::vector<detail::coeff_file_entry> directory(curves.size());
+			uint64_t offset = detail::align_up(header.directory_offset + directory.size() * sizeof(detail::coeff_file_entry));
+			for (size_t i = 0; i < curves.size(); ++i)
+			{
+				directory[i] = { offset, curves[i].samples, curves[i].ab.size(), 0 };
+				offset += detail::coeff_block_size(curves[i].ab.size(), is_float);
+			}
+
+			std::vector<unsigned char> bytes(detail::align_up(header.directory_offset + directory.size() * sizeof(detail::coeff_file_entry)));
+			std::memcpy(bytes.data(), &header, sizeof(header));
+			if (!directory.empty())
+				std::memcpy(bytes.data() + header.directory_offset, directory.data(), directory.size() * sizeof(detail::coeff_file_entry));
+			out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+			for (const auto& c : curves)
+			{
+				detail::make_coeff_block(bytes, c.a0, c.ab, is_float);
+				out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			}
+			return static_cast<bool>(out);
+		}
+
+	private:
+		struct curve
+		{
+			size_t samples;
+			complex_double a0;
+			std::vector<TrCoeff> ab;
+		};
+
+		bool is_float;
+		std::vector<curve> curves;
+	};
+
+	// Writes a coefficient file while the curves are still being produced: every block goes out
+	// when it is added, the directory follows the last block and close() finally rewrites the
+	// header to point at it. Only the directory is kept in memory. Until close() the header is
+	// zero, so an unfinished file is rejected by coeff_file.
+	class coeff_stream_writer
+	{
+		coeff_stream_writer(const coeff_stream_writer&) = delete;
+		coeff_stream_writer& operator =(const coeff_stream_writer&) = delete;
+
+	public:
+		explicit coeff_stream_writer(const std::string& path, bool single_precision = false) :
+			out(path, std::ios::binary | std::ios::trunc),
+			is_float(single_precision)
+		{
+			const detail::coeff_file_header header{};
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return static_cast<bool>(out);
+		}
+
+		size_t size() const noexcept
+		{
+			return directory.size();
+		}
+
+		template<class T> bool add(const basic_fourier<T>& f)
+		{
+			return add(f.size, complex_double(f.a0), f.ab);
+		}
+
+		template<class Coeff> bool add(size_t samples, const complex_double& a0, const std::vector<Coeff>& ab)
+		{
+			detail::make_coeff_block(bytes, a0, ab, is_float);
+			out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			directory.push_back({ offset, samples, ab.size(), 0 });
+			offset += bytes.size();
+			return static_cast<bool>(out);
+		}
+
+		bool close()
+		{
+			if (!directory.empty())
+				out.write(reinterpret_cast<const char*>(directory.data()), static_cast<std::streamsize>(directory.size() * sizeof(detail::coeff_file_entry)));
+			const auto header = detail::make_coeff_header(directory.size(), offset, is_float);
+			out.seekp(0);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.close();
+			return !out.fail();
+		}
+
+	private:
+		std::ofstream out;
+		bool is_float;
+		// blocks are multiples of the alignment, so every offset stays aligned
+		uint64_t offset = sizeof(detail::coeff_file_header);
+		std::vector<detail::coeff_file_entry> directory;
+		std::vector<unsigned char> bytes;
+	};
+
+	// Memory-mapped coefficient file. Opening checks the header and that every block lies inside
+	// the file; curves are then read in place through curve_view or copied into a fourier.
+	class coeff_file
+	{
+	public:
+		explicit coeff_file(const std::string& path) :
+			mapping(std::make_unique<detail::mapped_file>(path))
+		{
+			const auto bytes = mapping->data();
+			const auto length = static_cast<uint64_t>(mapping->size());
+			detail::coeff_file_header header;
+			if (!bytes || length < sizeof(header)) return;
+			std::memcpy(&header, bytes, sizeof(header));
+			if (std::memcmp(header.magic, detail::coeff_file_magic, sizeof(header.magic)) != 0
+				|| header.version != detail::coeff_file_version
+				|| header.byte_order != detail::coeff_file_byte_order
+				|| header.directory_offset % detail::coeff_file_alignment != 0
+				|| header.directory_offset > length
+				|| header.curve_count > (length - header.directory_offset) / sizeof(detail::coeff_file_entry))
+				return;
+
+			is_float = (header.flags & detail::coeff_file_float32) != 0;
+			views.resize(static_cast<size_t>(header.curve_count));
+			for (size_t i = 0; i < views.size(); ++i)
+			{
+				detail::coeff_file_entry entry;
+				std::memcpy(&entry, bytes + header.directory_offset + i * sizeof(entry), sizeof(entry));
+				if (entry.samples == 0 || entry.harmonics > entry.samples / 2 || entry.offset % detail::coeff_file_alignment != 0
+					|| entry.offset > length || detail::coeff_block_size(entry.harmonics, is_float) > length - entry.offset)
+				{
+					views.clear();
+					return;
+				}
+
+				auto& view = views[i];
+				view.block = bytes + entry.offset;
+				view.n = static_cast<size_t>(entry.samples);
+				view.m = static_cast<size_t>(entry.harmonics);
+				view.is_float = is_float;
+			}
+			valid = true;
+		}
+
+		bool is_open() const noexcept
+		{
+			return valid;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return valid;
+		}
+
+		// curves
+		size_t size() const noexcept
+		{
+			return views.size();
+		}
+
+		bool single_precision() const noexcept
+		{
+			return is_float;
+		}
+
+		const curve_view& curve(size_t index) const
+		{
+			return views[index];
+		}
+
+		// Copies a curve into f; the samples are gone, so residual() reads zero afterwards.
+		template<class T> void load(size_t index, basic_fourier<T>& f) const
+		{
+			using complex_type = std::complex<T>;
+			const auto& view = views[index];
+			f.ab.resize(view.m);
+			for (size_t k = 0; k < view.m; ++k)
+			{
+				const auto c = view.coeff(k);
+				f.ab[k] = { complex_type(c.first), complex_type(c.second) };
+			}
+			f.a0 = complex_type(view.firstCoeff());
+			f.size = view.n;
+			f.is_odd = view.n % 2 != 0;
+			f.square_value = -1; //reset;
+			f.harmonic_limit = view.m < view.n / 2 ? view.m : basic_fourier<T>::all_harmonics;
+			f.rms_tolerance = 0;
+			f.sample_energy = std::norm(f.a0);
+			for (const auto& c : f.ab)
+				f.sample_energy += (std::norm(c.first) + std::norm(c.second)) / 2;
+			f.coeffs_changed();
+		}
+
+	private:
+		std::unique_ptr<detail::mapped_file> mapping;
+		std::vector<curve_view> views;
+		bool is_float = false;
+		bool valid = false;
+	};
+}
@@ -0,0 +1,199 @@
+#pragma once
+#include <array>
+#include <utility>
+#include <algorithm>
+#include "trinterp.hpp"
+
+namespace fourtd
+{
+	// Series with a harmonic count M fixed at compile time. The coefficients sit in std::array and
+	// every evaluation is a fold over std::index_sequence<M>, so the loop over the harmonics is
+	// fully unrolled and the coefficients can stay in registers. Meant for small M (8, 16, 32);
+	// the rotation is re-anchored every detail::anchor_period harmonics like the batch kernels.
+	// Only the point-by-point paths beat basic_fourier: values() over more than a few hundred
+	// equispaced angles still costs O(M) per point, where basic_fourier::values takes one inverse
+	// FFT and is several times faster.
+	template<size_t M, class T> class fixed_fourier
+	{
+	public:
+		using value_type = T;
+		using complex_type = std::complex<T>;
+
+		static constexpr size_t harmonics = M;
+
+		// first M harmonics of f; missing ones are zero
+		explicit fixed_fourier(const basic_fourier<T>& f) :
+			a0(f.a0),
+			size(f.size)
+		{
+			for (size_t k = 0; k < std::min(M, f.ab.size()); ++k)
+			{
+				const auto& c = f.ab[k];
+				ar[k] = c.first.real();
+				ai[k] = c.first.imag();
+				br[k] = c.second.real();
+				bi[k] = c.second.imag();
+			}
+		}
+
+		template<class _FwdIt>
+		fixed_fourier(_FwdIt _First, _FwdIt _Last) :
+			fixed_fourier(basic_fourier<T>(_First, _Last, M))
+		{
+		}
+
+		const complex_type& firstCoeff() const noexcept
+		{
+			return a0;
+		}
+
+		T indexToAngle(T index) const noexcept
+		{
+			return (1 + 2 * index) * pi_v<T> / size;
+		}
+
+		complex_type nativ_value(T angle) const noexcept
+		{
+			T re = 0, im = 0;
+			const T step_cos = std::cos(angle), step_sin = std::sin(angle);
+			accumulate<false, 1>(&angle, &step_cos, &step_sin, &re, &im, std::make_index_sequence<M>{});
+			return a0 + complex_type(re, im);
+		}
+
+		// first derivative with respect to the angle, start_sincos = (cos(angle), sin(angle))
+		complex_type nativ_derivative_value(const complex_type& start_sincos) const noexcept
+		{
+			T re = 0, im = 0;
+			const T step_cos = start_sincos.real(), step_sin = start_sincos.imag();
+			// the angle is only read to re-anchor the rotation
+			const T angle = M > detail::anchor_period ? std::arg(start_sincos) : T(0);
+			accumulate<true, 1>(&angle, &step_cos, &step_sin, &re, &im, std::make_index_sequence<M>{});
+			return { re, im };
+		}
+
+		// out[i] = value at angles[i]; detail::batch_width points at a time, one unrolled pass over the harmonics
+		void nativ_values(const T* angles, size_t count, complex_type* out) const noexcept
+		{
+			constexpr size_t width = detail::batch_width;
+			T lane_angle[width], step_cos[width], step_sin[width];
+			for (size_t i = 0; i < count; i += width)
+			{
+				const size_t n = std::min(width, count - i);
+				for (size_t j = 0; j < width; ++j)
+				{
+					lane_angle[j] = j < n ? angles[i + j] : T(0);
+					step_cos[j] = std::cos(lane_angle[j]);
+					step_sin[j] = std::sin(lane_angle[j]);
+				}
+				evaluate(lane_angle, step_cos, step_sin, n, out + i);
+			}
+		}
+
+		complex_type value(T idx) const noexcept
+		{
+			return nativ_value(indexToAngle(idx));
+		}
+
+		complex_type derivative_value(T idx) const noexcept
+		{
+			const auto angle = indexToAngle(idx);
+			return nativ_derivative_value({ std::cos(angle), std::sin(angle) });
+		}
+
+		template<typename C, typename OutIt> void values(OutIt it, T a, T b, T delta = 0.01) const
+		{
+			if (size == 0) return;
+			const auto local_a = indexToAngle(a);
+			const auto local_b = indexToAngle(b);
+			const auto local_delta = 2 * delta * pi_v<T> / size;
+
+			// the angles are equispaced, so each lane's cos and sin come from one rotation of the
+			// previous point instead of std::cos and std::sin
+			constexpr size_t width = detail::batch_width;
+			const auto total = basic_fourier<T>::sample_count(local_a, local_b, local_delta);
+			typename basic_fourier<T>::TrigonometricIterator point(local_delta, local_a - local_delta);
+			T lane_angle[width] = {}, step_cos[width] = {}, step_sin[width] = {};
+			complex_type out[width];
+			for (size_t i = 0; i < total; i += width)
+			{
+				const size_t n = std::min(width, total - i);
+				for (size_t j = 0; j < n; ++j, ++point)
+				{
+					lane_angle[j] = point.angle();
+					step_cos[j] = point.cos();
+					step_sin[j] = point.sin();
+				}
+				evaluate(lane_angle, step_cos, step_sin, n, out);
+				for (size_t j = 0; j < n; ++j, ++it)
+					*it = detail::from_complex<C>(out[j]);
+			}
+		}
+
+	private:
+		// out[j] = value at lane j for j < count; the lanes past count are evaluated and dropped
+		FOURTD_TARGET_CLONES
+		void evaluate(const T* lane_angle, const T* step_cos, const T* step_sin, size_t count, complex_type* out) const noexcept
+		{
+			constexpr size_t width = detail::batch_width;
+			T re[width] = {}, im[width] = {};
+			accumulate<false, width>(lane_angle, step_cos, step_sin, re, im, std::make_index_sequence<M>{});
+			for (size_t j = 0; j < count; ++j)
+				out[j] = a0 + complex_type(re[j], im[j]);
+		}
+
+		template<bool derivative, size_t lanes, size_t... K>
+		void accumulate(const T* angle, const T* step_cos, const T* step_sin, T* re, T* im, std::index_sequence<K...>) const noexcept
+		{
+			T c[lanes], s[lanes];
+			std::copy_n(step_cos, lanes, c);
+			std::copy_n(step_sin, lanes, s);
+			(term<derivative, lanes, K>(angle, step_cos, step_sin, c, s, re, im), ...);
+		}
+
+		// adds harmonic K+1 at cos/sin (c, s), then moves c and s on to harmonic K+2
+		template<bool derivative, size_t lanes, size_t K>
+		void term(const T* angle, const T* step_cos, const T* step_sin, T* c, T* s, T* re, T* im) const noexcept
+		{
+			constexpr T k = static_cast<T>(K + 1);
+			const T kar = ar[K], kai = ai[K], kbr = br[K], kbi = bi[K];
+			for (size_t j = 0; j < lanes; ++j)
+			{
+				if constexpr (derivative)
+				{
+					re[j] += k * (kbr * c[j] - kar * s[j]);
+					im[j] += k * (kbi * c[j] - kai * s[j]);
+				}
+				else
+				{
+					re[j] += kar * c[j] + kbr * s[j];
+					im[j] += kai * c[j] + kbi * s[j];
+				}
+			}
+
+			if constexpr (K + 1 < M)
+			{
+				if constexpr ((K + 1) % detail::anchor_period == 0)
+				{
+					for (size_t j = 0; j < lanes; ++j)
+					{
+						c[j] = std::cos((k + 1) * angle[j]);
+						s[j] = std::sin((k + 1) * angle[j]);
+					}
+				}
+				else
+				{
+					for (size_t j = 0; j < lanes; ++j)
+					{
+						const T next_cos = c[j] * step_cos[j] - s[j] * step_sin[j];
+						s[j] = s[j] * step_cos[j] + c[j] * step_sin[j];
+						c[j] = next_cos;
+					}
+				}
+			}
+		}
+
+		complex_type a0;
+		std::array<T, M> ar{}, ai{}, br{}, bi{};
+		size_t size;
+	};
+}
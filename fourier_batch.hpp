@@ -0,0 +1,366 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <numeric>
+#include <iterator>
+#include <stdexcept>
+#include <algorithm>
+#include "trinterp.hpp"
+
+namespace fourtd
+{
+	namespace detail
+	{
+		// angles per shared trig block
+		inline constexpr size_t table_width = 64;
+
+		// cos/sin(k*angles[j]) for k = 1..harmonics and j < count, one row of table_width per harmonic;
+		// rotation from k to k+1, re-anchored every anchor_period harmonics
+		inline void trig_block(const double* angles, size_t count, size_t harmonics, double* cos_rows, double* sin_rows)
+		{
+			for (size_t j = 0; j < table_width; ++j)
+			{
+				const double angle = j < count ? angles[j] : 0.0;
+				const double step_cos = std::cos(angle), step_sin = std::sin(angle);
+				double c = step_cos, s = step_sin;
+				for (size_t k = 0; k < harmonics; ++k)
+				{
+					if (k != 0 && k % anchor_period == 0)
+					{
+						c = std::cos(static_cast<double>(k + 1) * angle);
+						s = std::sin(static_cast<double>(k + 1) * angle);
+					}
+					cos_rows[k * table_width + j] = c;
+					sin_rows[k * table_width + j] = s;
+					const double next_cos = c * step_cos - s * step_sin;
+					s = s * step_cos + c * step_sin;
+					c = next_cos;
+				}
+			}
+		}
+
+		// re/im[j] = sum_k (a_k*cos(k*t_j) + b_k*sin(k*t_j)) over one trig block
+		FOURTD_TARGET_CLONES
+		inline void accumulate_block(const double* ar, const double* ai, const double* br, const double* bi, size_t harmonics,
+			const double* cos_rows, const double* sin_rows, double* re, double* im) noexcept
+		{
+			double sum_re[table_width] = {}, sum_im[table_width] = {};
+			for (size_t k = 0; k < harmonics; ++k)
+			{
+				const double kar = ar[k], kai = ai[k], kbr = br[k], kbi = bi[k];
+				const double* c = cos_rows + k * table_width;
+				const double* s = sin_rows + k * table_width;
+				for (size_t j = 0; j < table_width; ++j)
+				{
+					sum_re[j] += kar * c[j] + kbr * s[j];
+					sum_im[j] += kai * c[j] + kbi * s[j];
+				}
+			}
+			for (size_t j = 0; j < table_width; ++j)
+			{
+				re[j] = sum_re[j];
+				im[j] = sum_im[j];
+			}
+		}
+	}
+
+	// Many curves of the same sample count N, fitted, evaluated and measured together. They share
+	// one FFT plan, and every block of evaluation angles gets one cos/sin table that all curves
+	// of a worker's chunk reuse. Coefficients sit contiguously, curve after curve, as
+	// ar[M], ai[M], br[M], bi[M]. Unlike fourier, the batch is copyable and movable.
+	class fourier_batch
+	{
+	public:
+		using TrCoeff = fourier::TrCoeff;
+
+		explicit fourier_batch(size_t samples_per_curve, size_t max_harmonics = fourier::all_harmonics) :
+			n(std::max<size_t>(1, samples_per_curve)),
+			m(std::min(max_harmonics, n / 2)),
+			plan(std::make_shared<const fft_plan>(n))
+		{
+		}
+
+		// curves
+		size_t size() const noexcept
+		{
+			return a0.size();
+		}
+
+		size_t samples_per_curve() const noexcept
+		{
+			return n;
+		}
+
+		size_t harmonics() const noexcept
+		{
+			return m;
+		}
+
+		void reserve(size_t curves)
+		{
+			a0.reserve(curves);
+			coeff.reserve(curves * 4 * m);
+		}
+
+		// fits one curve of N samples and returns its index
+		template<class _FwdIt> size_t push_back(_FwdIt _First, _FwdIt _Last)
+		{
+			std::vector<complex_double> samples;
+			for (; _First != _Last; ++_First)
+				samples.push_back(detail::to_complex<double>(*_First));
+			check_size(samples.size());
+
+			a0.emplace_back();
+			coeff.resize(coeff.size() + 4 * m);
+			std::vector<TrCoeff> ab;
+			fit(samples, a0.size() - 1, ab);
+			return a0.size() - 1;
+		}
+
+		// replaces the batch by one curve per element of [first, last), each a range of N samples,
+		// fitted in parallel
+		template<class _RanIt> void assign(_RanIt _First, _RanIt _Last)
+		{
+			const auto count = static_cast<size_t>(std::distance(_First, _Last));
+			a0.assign(count, {});
+			coeff.assign(count * 4 * m, 0.0);
+			workers().parallel_for(0, count, [this, _First](size_t first, size_t last)
+				{
+					std::vector<complex_double> samples;
+					std::vector<TrCoeff> ab;
+					for (; first != last; ++first)
+					{
+						samples.clear();
+						for (const auto& pt : *(_First + static_cast<std::ptrdiff_t>(first)))
+							samples.push_back(detail::to_complex<double>(pt));
+						check_size(samples.size());
+						fit(samples, first, ab);
+					}
+				}, 16
+			);
+		}
+
+		double indexToAngle(double index) const noexcept
+		{
+			return (1 + 2 * index) * pi / static_cast<double>(n);
+		}
+
+		const complex_double& firstCoeff(size_t curve) const
+		{
+			return a0[curve];
+		}
+
+		std::vector<TrCoeff> coeffs(size_t curve) const
+		{
+			const auto c = block(curve);
+			std::vector<TrCoeff> result(m);
+			for (size_t k = 0; k < m; ++k)
+				result[k] = { { c[k], c[m + k] }, { c[2 * m + k], c[3 * m + k] } };
+			return result;
+		}
+
+		complex_double nativ_value(size_t curve, double angle) const
+		{
+			const auto c = block(curve);
+			auto sum = a0[curve];
+			fourier::TrigonometricIterator it(std::polar(1.0, angle), 0.0);
+			for (size_t k = 0; k < m; ++k, ++it)
+				sum += complex_double(c[k], c[m + k]) * it.cos() + complex_double(c[2 * m + k], c[3 * m + k]) * it.sin();
+			return sum;
+		}
+
+		// out[c * angles.size() + j] = curve c at angles[j]
+		std::vector<complex_double> values(const std::vector<double>& angles) const
+		{
+			const size_t count = angles.size();
+			std::vector<complex_double> out(size() * count);
+			workers().parallel_for(0, size(), [this, &angles, &out, count](size_t first, size_t last)
+				{
+					sweep(first, last, count, [&angles](size_t j) { return angles[j]; },
+						[this](size_t curve) { return block(curve); },
+						[this, &out, count](size_t curve, size_t j0, size_t width, const double* re, const double* im)
+						{
+							for (size_t j = 0; j < width; ++j)
+								out[curve * count + j0 + j] = a0[curve] + complex_double(re[j], im[j]);
+						}
+					);
+				}, 16
+			);
+			return out;
+		}
+
+		// areas of all curves, as fourier::square
+		std::vector<double> squares() const
+		{
+			std::vector<double> result(size());
+			workers().parallel_for(0, size(), [this, &result](size_t first, size_t last)
+				{
+					for (; first != last; ++first)
+					{
+						const auto c = block(first);
+						double sum = 0.0;
+						for (size_t k = 0; k < m; ++k)
+							sum += c[k] * c[3 * m + k] - c[m + k] * c[2 * m + k];
+						result[first] = pi * std::abs(sum);
+					}
+				}, 256
+			);
+			return result;
+		}
+
+		// Closed-curve length of all curves. The periodic trapezoid rule runs on nodes shared by all
+		// curves; a curve leaves the refinement once two successive refinements each change its
+		// estimate by at most max(eps, rel_eps * length), as in fourier::length.
+		std::vector<double> lengths(double eps = 0.1, double rel_eps = 0.0) const
+		{
+			std::vector<double> result(size());
+			if (m == 0) return result;
+
+			workers().parallel_for(0, size(), [this, &result, eps, rel_eps](size_t first, size_t last)
+				{
+					// f' = sum_k k*(b_k*cos(k*t) - a_k*sin(k*t)), in the same layout
+					std::vector<double> derivative((last - first) * 4 * m);
+					for (size_t curve = first; curve != last; ++curve)
+					{
+						const auto c = block(curve);
+						auto d = derivative.data() + (curve - first) * 4 * m;
+						for (size_t k = 0; k < m; ++k)
+						{
+							const auto factor = static_cast<double>(k + 1);
+							d[k] = factor * c[2 * m + k];
+							d[m + k] = factor * c[3 * m + k];
+							d[2 * m + k] = -factor * c[k];
+							d[3 * m + k] = -factor * c[m + k];
+						}
+					}
+
+					std::vector<size_t> active(last - first);
+					std::iota(active.begin(), active.end(), first);
+					std::vector<double> sums(last - first);
+					const auto speed_sums = [&](double start, double step, size_t count)
+					{
+						std::fill(sums.begin(), sums.end(), 0.0);
+						sweep_curves(active, count, [start, step](size_t j) { return start + static_cast<double>(j) * step; },
+							[&derivative, first, this](size_t curve) { return derivative.data() + (curve - first) * 4 * m; },
+							[&sums, first](size_t curve, size_t, size_t width, const double* re, const double* im)
+							{
+								double sum = 0.0;
+								for (size_t j = 0; j < width; ++j)
+									sum += std::hypot(re[j], im[j]);
+								sums[curve - first] += sum;
+							}
+						);
+					};
+
+					size_t nodes = std::max<size_t>(16, 2 * m);
+					double h = 2 * pi / static_cast<double>(nodes);
+					speed_sums(0.0, h, nodes);
+					std::vector<double> trapezoid(last - first);
+					std::vector<int> settled(last - first);
+					for (const auto curve : active)
+						trapezoid[curve - first] = h * sums[curve - first];
+
+					for (size_t level = 1; level <= max_length_levels && !active.empty(); ++level, nodes *= 2, h /= 2)
+					{
+						speed_sums(h / 2, h, nodes);
+						std::vector<size_t> still_active;
+						for (const auto curve : active)
+						{
+							auto& t = trapezoid[curve - first];
+							auto& s = settled[curve - first];
+							const auto next = t / 2 + h / 2 * sums[curve - first];
+							s = std::abs(next - t) <= std::max(eps, rel_eps * next) ? s + 1 : 0;
+							if (s < 2)
+								still_active.push_back(curve);
+							t = next;
+						}
+						active = std::move(still_active);
+					}
+
+					std::copy(trapezoid.cbegin(), trapezoid.cend(), result.begin() + static_cast<std::ptrdiff_t>(first));
+				}, 16
+			);
+			return result;
+		}
+
+		// fitting, values, squares and lengths run on this pool; thread_pool::shared() unless set
+		thread_pool& workers() const noexcept
+		{
+			return pool ? *pool : thread_pool::shared();
+		}
+
+		void set_workers(thread_pool& workers) noexcept
+		{
+			pool = &workers;
+		}
+
+	private:
+		static constexpr size_t max_length_levels = 20;
+
+		void check_size(size_t count) const
+		{
+			if (count != n)
+				throw std::invalid_argument("fourier_batch: every curve needs the same number of samples");
+		}
+
+		const double* block(size_t curve) const
+		{
+			return coeff.data() + curve * 4 * m;
+		}
+
+		void fit(std::vector<complex_double>& samples, size_t curve, std::vector<TrCoeff>& ab)
+		{
+			plan->forward(samples.data());
+			ab.clear();
+			a0[curve] = fourier::spectrum_coeffs(samples, m, ab);
+
+			auto c = coeff.data() + curve * 4 * m;
+			for (size_t k = 0; k < m; ++k)
+			{
+				c[k] = ab[k].first.real();
+				c[m + k] = ab[k].first.imag();
+				c[2 * m + k] = ab[k].second.real();
+				c[3 * m + k] = ab[k].second.imag();
+			}
+		}
+
+		// visit(curve, j0, width, re, im) gets the series of every curve in [first, last) at the
+		// angles j0..j0+width; each block of angles builds one trig table for all of them
+		template<class AngleAt, class CoeffOf, class Visit>
+		void sweep(size_t first, size_t last, size_t count, AngleAt&& angle_at, CoeffOf&& coeff_of, Visit&& visit) const
+		{
+			std::vector<size_t> curves(last - first);
+			std::iota(curves.begin(), curves.end(), first);
+			sweep_curves(curves, count, angle_at, coeff_of, visit);
+		}
+
+		template<class AngleAt, class CoeffOf, class Visit>
+		void sweep_curves(const std::vector<size_t>& curves, size_t count, AngleAt&& angle_at, CoeffOf&& coeff_of, Visit&& visit) const
+		{
+			constexpr auto width = detail::table_width;
+			std::vector<double> cos_rows(m * width), sin_rows(m * width);
+			double angles[width], re[width], im[width];
+			for (size_t j0 = 0; j0 < count; j0 += width)
+			{
+				const auto block_width = std::min(width, count - j0);
+				for (size_t j = 0; j < block_width; ++j)
+					angles[j] = angle_at(j0 + j);
+				detail::trig_block(angles, block_width, m, cos_rows.data(), sin_rows.data());
+
+				for (const auto curve : curves)
+				{
+					const auto c = coeff_of(curve);
+					detail::accumulate_block(c, c + m, c + 2 * m, c + 3 * m, m, cos_rows.data(), sin_rows.data(), re, im);
+					visit(curve, j0, block_width, re, im);
+				}
+			}
+		}
+
+		size_t n;
+		size_t m;
+		std::shared_ptr<const fft_plan> plan;
+		std::vector<complex_double> a0;
+		std::vector<double> coeff;
+		thread_pool* pool = nullptr;
+	};
+}
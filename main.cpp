@@ -1,20 +1,36 @@
 #include <stdlib.h>
+#include <cstdint>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <memory>
+#include <functional>
+#include <fstream>
+#include <filesystem>
+#include <array>
+#include <cstdio>
+#include <cstring>
 #include <QtGui>
 #include <QtWidgets>
 #include <blend2d.h>
 
 #include "trinterp.hpp"
+#include "coeff_file.hpp"
+#include "trace.hpp"
+#include "thread_pool.hpp"
 
 using namespace std::complex_literals;
 
 namespace fourtd
 {
-	template<> inline complex_double fourier::make_complex<const BLPoint&> [[nodiscard]] (const BLPoint& c)
+	template<> inline complex_double make_complex<const BLPoint&> [[nodiscard]] (const BLPoint& c)
 	{
 		return { c.x,c.y };
 	}
 
-	template<> inline BLPoint fourier::make_value<BLPoint> [[nodiscard]] (const complex_double& z)
+	template<> inline BLPoint make_value<BLPoint> [[nodiscard]] (const complex_double& z)
 	{
 		return { z.real(), z.imag() };
 	}
@@ -24,7 +40,7 @@ using namespace fourtd;
 
 namespace
 {
-	inline const QList<BLPoint> pi_symbol =
+	inline const std::vector<BLPoint> pi_symbol =
 	{
 		{408.0,130.0}
 		,{503.0,132.0}
@@ -54,40 +70,635 @@ namespace
 		,{188.0,131.0}
 		,{243.0,131.0}
 	};
-	constexpr double sel_tolerance = 7.0 * 7.0;
+	constexpr double sel_radius = 7.0;
+	constexpr double sel_tolerance = sel_radius * sel_radius;
+	// harmonics whose epicycles add up to less than this many pixels are not drawn
+	constexpr double render_tolerance = 0.25;
 }
 
-class QCanvasWidget : public QWidget
+// Uniform grid over the control points for hit tests within sel_radius. Cells are sel_radius
+// wide, so a query reads the 3x3 cells around the test point. Cells hold stable point ids, not
+// positions: a drag moves one id between two cells, and an insert or erase only touches the cell
+// of that point plus the id -> position table behind the edit, which shifts like the point vector.
+class point_grid
 {
 public:
+	static constexpr size_t npos = static_cast<size_t>(-1);
 
-	QCanvasWidget() :
-		f(pts.cbegin(), pts.cend())
+	void assign(const std::vector<BLPoint>& pts)
+	{
+		cells.clear();
+		free_ids.clear();
+		id_of.resize(pts.size());
+		pos_of.resize(pts.size());
+		for (size_t i = 0; i < pts.size(); ++i)
+		{
+			id_of[i] = pos_of[i] = i;
+			cells[key(pts[i])].push_back(i);
+		}
+	}
+
+	// position of the nearest point within sel_radius of test_pt, or npos
+	size_t find(const std::vector<BLPoint>& pts, const BLPoint& test_pt) const
+	{
+		size_t result = npos;
+		double best = sel_tolerance;
+		const auto cx = coord(test_pt.x);
+		const auto cy = coord(test_pt.y);
+		for (std::int64_t x = cx - 1; x <= cx + 1; ++x)
+		{
+			for (std::int64_t y = cy - 1; y <= cy + 1; ++y)
+			{
+				const auto cell = cells.find(pack(x, y));
+				if (cell == cells.end())
+					continue;
+				for (const auto id : cell->second)
+				{
+					const auto i = pos_of[id];
+					const auto d = pts[i] - test_pt;
+					const auto dist = d.x * d.x + d.y * d.y;
+					if (dist < best)
+					{
+						best = dist;
+						result = i;
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	void move(size_t index, const BLPoint& from, const BLPoint& to)
+	{
+		const auto old_key = key(from);
+		const auto new_key = key(to);
+		if (old_key == new_key)
+			return;
+		remove(old_key, id_of[index]);
+		cells[new_key].push_back(id_of[index]);
+	}
+
+	void insert(size_t index, const BLPoint& pt)
+	{
+		size_t id = pos_of.size();
+		if (free_ids.empty())
+		{
+			pos_of.push_back(index);
+		}
+		else
+		{
+			id = free_ids.back();
+			free_ids.pop_back();
+		}
+		id_of.insert(id_of.begin() + static_cast<std::ptrdiff_t>(index), id);
+		renumber(index);
+		cells[key(pt)].push_back(id);
+	}
+
+	void erase(size_t index, const BLPoint& pt)
+	{
+		const auto id = id_of[index];
+		remove(key(pt), id);
+		id_of.erase(id_of.begin() + static_cast<std::ptrdiff_t>(index));
+		free_ids.push_back(id);
+		renumber(index);
+	}
+
+private:
+	static std::int64_t coord(double v)
 	{
+		return static_cast<std::int64_t>(std::floor(v / sel_radius));
+	}
 
+	static std::uint64_t pack(std::int64_t x, std::int64_t y)
+	{
+		return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+	}
+
+	static std::uint64_t key(const BLPoint& pt)
+	{
+		return pack(coord(pt.x), coord(pt.y));
+	}
+
+	// positions from index on have shifted by one
+	void renumber(size_t index)
+	{
+		for (size_t i = index; i < id_of.size(); ++i)
+			pos_of[id_of[i]] = i;
+	}
+
+	void remove(std::uint64_t cell_key, size_t id)
+	{
+		const auto cell = cells.find(cell_key);
+		if (cell == cells.end())
+			return;
+		auto& ids = cell->second;
+		const auto it = std::find(ids.begin(), ids.end(), id);
+		if (it == ids.end())
+			return;
+		ids.erase(it);
+		if (ids.empty())
+			cells.erase(cell);
+	}
+
+	std::unordered_map<std::uint64_t, std::vector<size_t>> cells;
+	// position -> id and id -> position; ids of erased points are reused
+	std::vector<size_t> id_of;
+	std::vector<size_t> pos_of;
+	std::vector<size_t> free_ids;
+};
+
+// One change of the control points. A series fitted to the points before the change follows it
+// with update_point, insert_point or erase_point instead of a refit.
+struct point_edit
+{
+	enum kind_type { move, insert, erase } kind;
+	size_t index;
+	// old position of a moved point
+	BLPoint from;
+	// new position of a moved or inserted point
+	BLPoint to;
+
+	void apply(fourier& f) const
+	{
+		switch (kind)
+		{
+		case move:
+			f.update_point(index, { from.x, from.y }, { to.x, to.y });
+			break;
+		case insert:
+			f.insert_point(index, { to.x, to.y });
+			break;
+		case erase:
+			f.erase_point(index);
+			break;
+		}
+	}
+};
+
+// everything a frame depends on, copied from the GUI thread
+struct canvas_state
+{
+	std::vector<BLPoint> pts;
+	// bumped on every change of pts: once per point_edit, once for a replacement of all of them
+	size_t version = 0;
+	// band of the fit; a loaded curve keeps the harmonics of its file
+	size_t harmonics = fourier::all_harmonics;
+	bool is_close = true;
+	bool show_circles{};
+	bool show_broken_line{};
+	bool show_tangent{};
+	bool show_normal{};
+	// tracer position as a fraction of the arc length
+	double phase{};
+	QSize size;
+};
+
+// first curve of a coefficient file into f; pts become its samples
+bool loadCurve(const std::string& path, fourier& f, std::vector<BLPoint>& pts)
+{
+	const coeff_file file(path);
+	if (!file || file.size() == 0)
+		return false;
+
+	file.load(0, f);
+	pts.clear();
+	for (const auto& z : f.samples())
+		pts.push_back({ z.real(), z.imag() });
+	return true;
+}
+
+using epicycle_radii = std::vector<std::pair<complex_double, complex_double>>;
+
+// A*cos(w)+B*sin(w) ->  Z1*e^iw+Z2*^-iw for every harmonic of f
+epicycle_radii radiiOf(const fourier& f)
+{
+	FOURTD_TRACE_SCOPE("fit.radii");
+	const auto& coeff = f.coeffs();
+	epicycle_radii rad;
+	rad.reserve(coeff.size());
+	for (const auto& c : coeff)
+	{
+		rad.emplace_back
+		(
+			std::piecewise_construct,
+			std::forward_as_tuple((c.first.real() + c.second.imag()) / 2.0, (c.first.imag() - c.second.real()) / 2.0),
+			std::forward_as_tuple((c.first.real() - c.second.imag()) / 2.0, (c.first.imag() + c.second.real()) / 2.0)
+		);
+	}
+	return rad;
+}
+
+// Background, curve and control points; drawn once per change of the curve. interp receives the
+// tessellated curve, within tolerance of it in user units of ctx.
+void paintLayer(BLContext& ctx, const fourier& f, const canvas_state& state, double tolerance, std::vector<BLPoint>& interp)
+{
+	FOURTD_TRACE_SCOPE("layer");
+	ctx.setFillStyle(BLRgba32(0xFF000000u));
+	ctx.fillAll();
+
+	if (state.pts.size() > 1)
+	{
+		// points only where the curve turns
+		{
+			FOURTD_TRACE_SCOPE("layer.tessellate");
+			interp.clear();
+			f.lod(tolerance).tessellate<BLPoint>(std::back_inserter(interp), 0, state.pts.size() - 1.0 + static_cast<int>(state.is_close), tolerance);
+		}
+		FOURTD_TRACE_COUNTER("tessellated", interp.size());
+
+		ctx.setStrokeStyle(BLRgba32(0xFFFFFF00u));
+
+		ctx.setStrokeWidth(4);
+		if (state.is_close)
+			ctx.strokePolygon(&interp[0], interp.size());
+		else
+			ctx.strokePolyline(&interp[0], interp.size());
+	}
+
+	BLPath path;
+
+	for (const auto& pt : state.pts)
+	{
+		path.addCircle(BLCircle(pt.x, pt.y, 3));
+	}
+	ctx.setFillStyle(BLRgba32(0xFFFFFFFFu));
+	ctx.fillPath(path);
+}
+
+// Epicycles, tangent and normal at the tracer; O(M) per frame. The geometry buffers are kept from
+// frame to frame, so every thread that draws frames needs its own painter.
+class overlay_painter
+{
+public:
+	// size the buffers once per fit; frames only overwrite them
+	void reserve(size_t harmonics)
+	{
+		const auto spoke_count = 2 * harmonics;
+		spokes.resize(spoke_count);
+		joints.resize(spoke_count + 1);
+		circles_path.clear();
+		circles_path.reserve(spoke_count * circle_vertices);
+		joints_path.clear();
+		joints_path.reserve(spoke_count * circle_vertices);
+	}
+
+	void paint(BLContext& ctx, const fourier& f, const epicycle_radii& radii, const canvas_state& state)
+	{
+		FOURTD_TRACE_SCOPE("overlay");
+		if (state.pts.size() > 1)
+		{
+			if (state.show_circles || state.show_tangent || state.show_normal || state.show_broken_line)
+			{
+				// equal phase steps cover equal arc length, so the tracer moves at constant speed
+				const auto pos = f.parameterAtLength(state.phase * f.totalLength());
+				const auto angle = f.indexToAngle(pos);
+
+				// point and tangent in one sweep over the harmonics
+				const auto jet = f.nativ_jet(angle);
+				const auto& cur_pt = jet.value;
+				const auto& der = jet.first;
+
+				buildSpokes(radii, angle);
+
+				complex_double sum = f.firstCoeff();
+				joints[0] = BLPoint(sum.real(), sum.imag());
+				circles_path.clear();
+				joints_path.clear();
+				for (size_t i = 0; i < spokes.size(); ++i)
+				{
+					if (state.show_circles)
+						circles_path.addCircle(BLCircle(sum.real(), sum.imag(), std::abs(spokes[i])));
+					sum += spokes[i];
+					joints[i + 1] = BLPoint(sum.real(), sum.imag());
+					if (state.show_broken_line)
+						joints_path.addCircle(BLCircle(sum.real(), sum.imag(), 2));
+				}
+
+				if (state.show_circles)
+				{
+					ctx.setStrokeWidth(2);
+					ctx.setStrokeStyle(BLRgba32(0xF000B3B3u));
+					ctx.strokePath(circles_path);
+				}
+
+				ctx.setStrokeWidth(1);
+
+				if (state.show_broken_line)
+				{
+					ctx.setStrokeWidth(2);
+					ctx.setStrokeStyle(BLRgba32(0xFFFFFFFFu));
+					ctx.setFillStyle(BLRgba32(0xFFFFFFFFu));
+					ctx.strokePolyline(joints.data(), joints.size());
+					ctx.fillPath(joints_path);
+				}
+
+				ctx.setStrokeWidth(1);
+				ctx.setStrokeStyle(BLRgba32(0xFFFF0000u));
+
+				if (state.show_tangent)
+					ctx.strokeLine(cur_pt.real() - der.real(),cur_pt.imag() - der.imag(),cur_pt.real() + der.real(),cur_pt.imag() + der.imag());
+
+				if (state.show_normal)
+					ctx.strokeLine(cur_pt.real() - der.imag(),cur_pt.imag() + der.real(), cur_pt.real() + der.imag(),cur_pt.imag() - der.real());
+				ctx.setStrokeWidth(3);
+				ctx.strokeCircle(joints.back().x, joints.back().y, 4);
+			}
+		}
+	}
+
+private:
+	// epicycle vectors at angle, ordered -M..-1, 1..M: spokes[M - k] = z2_k*e^-ikw, spokes[M + k - 1] = z1_k*e^ikw
+	void buildSpokes(const epicycle_radii& radii, double angle)
+	{
+		const auto m = radii.size();
+		const complex_double step(std::cos(angle), std::sin(angle));
+		auto sincos = step;
+		for (size_t k = 1; k <= m; ++k)
+		{
+			const auto& r = radii[k - 1];
+			spokes[m - k] = r.second * std::conj(sincos);
+			spokes[m + k - 1] = r.first * sincos;
+			// re-anchor like the evaluation kernels so the rotation does not drift for large m
+			if (k % detail::anchor_period == 0)
+				sincos = std::polar(1.0, static_cast<double>(k + 1) * angle);
+			else
+				sincos *= step;
+		}
+	}
+
+	static constexpr size_t circle_vertices = 14;
+	std::vector<complex_double> spokes;
+	std::vector<BLPoint> joints;
+	BLPath circles_path;
+	BLPath joints_path;
+};
+
+// Fits, measures and draws on its own thread. post() replaces a state that has not been picked up
+// yet, so a burst of edits is drawn once, with the newest state; the point edits of the burst are
+// queued and replayed on the series before that frame. Each frame goes to a back buffer
+// that is then swapped with the front one; ready() is called on the render thread afterwards with
+// the new window title, or an empty one when the curve did not change. It is the only thread
+// that fits; the GUI thread hit-tests against hit_series().
+class canvas_renderer
+{
+	canvas_renderer(const canvas_renderer&) = delete;
+	canvas_renderer& operator =(const canvas_renderer&) = delete;
+
+public:
+	explicit canvas_renderer(std::function<void(const QString&)> ready) :
+		ready(std::move(ready))
+	{
 		createInfo.threadCount = std::thread::hardware_concurrency();
+		worker = std::thread([this] { run(); });
+	}
+
+	~canvas_renderer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+
+	void post(canvas_state state)
+	{
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			pending = std::move(state);
+		}
+		wake.notify_one();
+	}
+
+	// state after edit; edits that were not picked up yet are kept and replayed in order
+	void post(canvas_state state, const point_edit& edit)
+	{
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			pending = std::move(state);
+			pending_edits.push_back(edit);
+		}
+		wake.notify_one();
+	}
+
+	// draws the newest finished frame
+	void present(QPainter& painter)
+	{
+		std::lock_guard<std::mutex> lock(frame_mutex);
+		painter.drawImage(QPoint{ 0, 0 }, front);
+	}
+
+	// Series for hit testing on the GUI thread, null until the first one is fitted. It is
+	// refitted once the points have been still for hit_delay, so it may lag behind them.
+	std::shared_ptr<const fourier> hit_series() const
+	{
+		std::lock_guard<std::mutex> lock(hit_mutex);
+		return hit;
+	}
+
+private:
+	static constexpr std::chrono::milliseconds hit_delay{ 100 };
+
+	void run()
+	{
+		std::vector<point_edit> edits;
+		std::optional<canvas_state> last;
+		for (;;)
+		{
+			canvas_state state;
+			{
+				std::unique_lock<std::mutex> lock(state_mutex);
+				const auto woken = [this] { return stopping || pending; };
+				if (last && last->version != hit_version && !wake.wait_for(lock, hit_delay, woken))
+				{
+					lock.unlock();
+					publish_hit(*last);
+					continue;
+				}
+				wake.wait(lock, woken);
+				if (stopping)
+					return;
+				state = std::move(*pending);
+				pending.reset();
+				edits.swap(pending_edits);
+				pending_edits.clear();
+			}
+			ready(frame(state, edits));
+			last = std::move(state);
+		}
+	}
+
+	// a separate series, so the GUI never shares f; the closest-point tree is built here too
+	void publish_hit(const canvas_state& state)
+	{
+		FOURTD_TRACE_SCOPE("fit.hit");
+		auto series = std::make_shared<fourier>(state.pts.cbegin(), state.pts.cend(), state.harmonics);
+		series->lengthToPoint({});
+		hit_version = state.version;
+		std::lock_guard<std::mutex> lock(hit_mutex);
+		hit = std::move(series);
+	}
+
+	QString frame(const canvas_state& state, const std::vector<point_edit>& edits)
+	{
+		FOURTD_TRACE_SCOPE("frame");
+		QString title;
+		if (!f || state.version != fitted_version)
+			title = fit(state, edits);
+
+		if (back.size() != state.size)
+			back = QImage(state.size, QImage::Format_ARGB32_Premultiplied);
+		if (back.isNull())
+			return title;
+
+		// the curve and the control points change only with the points, the closing or the size
+		if (!layer_version || *layer_version != state.version || layer_close != state.is_close
+			|| layer.width() != back.width() || layer.height() != back.height())
+		{
+			layer.create(back.width(), back.height(), BL_FORMAT_PRGB32);
+			BLContext ctx(layer, createInfo);
+			paintLayer(ctx, *f, state, render_tolerance, interp);
+			ctx.end();
+			layer_version = state.version;
+			layer_close = state.is_close;
+		}
+
+		BLImage image;
+		image.createFromData(back.width(), back.height(), BL_FORMAT_PRGB32, back.bits(), back.bytesPerLine());
+		BLContext ctx(image, createInfo);
+		ctx.setCompOp(BL_COMP_OP_SRC_COPY);
+		ctx.blitImage(BLPoint(0, 0), layer);
+		ctx.setCompOp(BL_COMP_OP_SRC_OVER);
+		overlay.paint(ctx, *f, radii, state);
+		ctx.end();
+
+		std::lock_guard<std::mutex> lock(frame_mutex);
+		std::swap(front, back);
+		return title;
+	}
+
+	// Replays edits when they are exactly the changes since the fitted version, O(M) per moved
+	// point; refits from state.pts after anything else, such as a new set of points.
+	QString fit(const canvas_state& state, const std::vector<point_edit>& edits)
+	{
+		FOURTD_TRACE_SCOPE("fit");
+		FOURTD_TRACE_COUNTER("points", state.pts.size());
+		if (f && fitted_version + edits.size() == state.version)
+		{
+			FOURTD_TRACE_SCOPE("fit.edits");
+			for (const auto& edit : edits)
+				edit.apply(*f);
+		}
+		else
+		{
+			FOURTD_TRACE_SCOPE("fit.coeff");
+			if (f)
+				f->calcul_coeff(state.pts.cbegin(), state.pts.cend(), state.harmonics);
+			else
+				f = std::make_unique<fourier>(state.pts.cbegin(), state.pts.cend(), state.harmonics);
+		}
+		fitted_version = state.version;
+
+		auto rad_future = f->workers().submit([this] { return radiiOf(*f); });
+
+		const auto count = static_cast<double>(state.pts.size());
+		auto square = f->workers().submit([this] { FOURTD_TRACE_SCOPE("fit.square"); return f->square(); });
+		auto length = f->workers().submit([this, count] { FOURTD_TRACE_SCOPE("fit.length"); return f->length(0, count, 0.0, 1e-6); });
+		radii = rad_future.get();
+		overlay.reserve(radii.size());
+		return QString("fourier - S=%1 , Len=%2").arg(square.get()).arg(length.get());
+	}
+
+	std::function<void(const QString&)> ready;
+	BLContextCreateInfo createInfo{};
+
+	// render thread only
+	std::unique_ptr<fourier> f;
+	size_t fitted_version = 0;
+	std::optional<size_t> hit_version;
+	std::vector<BLPoint> interp;
+	// version and closing the layer was drawn for, none before the first one
+	std::optional<size_t> layer_version;
+	bool layer_close = true;
+	epicycle_radii radii;
+	overlay_painter overlay;
+	BLImage layer;
+	QImage back;
+
+	std::mutex frame_mutex;
+	QImage front;
+
+	mutable std::mutex hit_mutex;
+	std::shared_ptr<const fourier> hit;
+
+	std::mutex state_mutex;
+	std::condition_variable wake;
+	std::optional<canvas_state> pending;
+	std::vector<point_edit> pending_edits;
+	bool stopping = false;
+	std::thread worker;
+};
+
+class QCanvasWidget : public QWidget
+{
+public:
+
+	QCanvasWidget() :
+		renderer([this](const QString& title)
+			{
+				// called on the render thread; the swap is shown from the GUI thread
+				QMetaObject::invokeMethod(this, [this, title]
+					{
+						if (!title.isEmpty() && parentWidget())
+							parentWidget()->setWindowTitle(title);
+						update();
+					}, Qt::QueuedConnection
+				);
+			}
+		)
+	{
+		grid.assign(pts);
 	}
 
 	void clear()
 	{
 		pts.clear();
-		cur_point = pts.end();
-		updateCoeff();
-		updateCanvas();
+		grid.assign(pts);
+		cur_point = point_grid::npos;
+		harmonics = fourier::all_harmonics;
+		pointsChanged();
 	}
 
 	void setPi()
 	{
 		pts = pi_symbol;
-		cur_point = pts.end();
-		updateCoeff();
-		updateCanvas();
+		grid.assign(pts);
+		cur_point = point_grid::npos;
+		harmonics = fourier::all_harmonics;
+		pointsChanged();
+	}
+
+	// first curve of a coefficient file; the control points are its samples
+	bool load(const std::string& path)
+	{
+		fourier loaded(pts.cbegin(), pts.cbegin());
+		if (!loadCurve(path, loaded, pts))
+			return false;
+
+		// the renderer refits the samples within the same band, so it draws the file's curve
+		harmonics = loaded.coeffs().size();
+		grid.assign(pts);
+		cur_point = point_grid::npos;
+		pointsChanged();
+		return true;
 	}
 
 	void setPos(double value)
 	{
-		pos = value / (2 * fourtd::pi) * pts.size();
-		updateCanvas(true);
+		phase = value / (2 * fourtd::pi);
+		updateCanvas();
 	}
 
 	void setShowCircles(bool value)
@@ -117,278 +728,496 @@ public:
 
 	void setIsClose(bool value)
 	{
-		interp.clear();
 		is_close = value;
 		updateCanvas();
 	}
 
-private:
-	void renderCanvas()
+	void setShowTimings(bool value)
 	{
-		BLContext ctx(blImage, createInfo);
-		onRenderB2D(ctx);
-		ctx.end();
+		show_timings = value;
+		update();
 	}
 
-	void updateCanvas(bool force = false)
+	bool exportTrace(const std::string& path) const
 	{
-		if (force)
-			renderCanvas();
-		else
-			dirty = true;
-		repaint();
+		std::ofstream out(path, std::ios::binary);
+		trace::write_chrome_trace(out, trace::events().snapshot());
+		return static_cast<bool>(out);
 	}
 
-	void resizeCanvas()
+private:
+	// hands the current state to the render thread; never waits for it
+	void updateCanvas()
 	{
-		const auto sz = size();
-		if (substr.size() == sz)
-			return;
-		substr = QImage(sz, QImage::Format_ARGB32_Premultiplied);
-		blImage.createFromData(substr.width(), substr.height(), BL_FORMAT_PRGB32, substr.bits(), substr.bytesPerLine());
-		updateCanvas(false);
+		renderer.post(snapshot());
 	}
 
-	bool dirty = {};
-
-	void resizeEvent(QResizeEvent*) override
+	canvas_state snapshot() const
 	{
-		resizeCanvas();
+		return { pts, version, harmonics, is_close, show_circles, show_broken_line, show_tangent, show_normal, phase, size() };
 	}
 
-	void updateCoeff()
+	// all points replaced; the renderer refits them
+	void pointsChanged()
 	{
-		interp.clear();
-		f.calcul_coeff(pts.cbegin(), pts.cend());
-
-		auto rad_future = std::async
-		(	
-			std::launch::async,
-			[this]()
-			{
-				const auto& coeff = f.coeffs();
-				decltype(radii) rad;
-				rad.reserve(coeff.size());
-				for (const auto& c : coeff)
-				{
-					// A*cos(w)+B*sin(w) ->  Z1*e^iw+Z2*^-iw
-					rad.emplace_back
-					(
-						std::piecewise_construct,
-						std::forward_as_tuple((c.first.real() + c.second.imag()) / 2.0, (c.first.imag() - c.second.real()) / 2.0),
-						std::forward_as_tuple((c.first.real() - c.second.imag()) / 2.0, (c.first.imag() + c.second.real()) / 2.0)
-					);
-				}
-				return rad;
-			}
-		);
+		++version;
+		updateCanvas();
+	}
 
-		if (parentWidget())
-		{
-			auto square = std::async(std::launch::async, [this] { return f.square(); });
-			auto length = std::async(std::launch::async, [this] { return f.length(0, 2 * fourtd::pi); });
-			parentWidget()->setWindowTitle(QString("fourier - S=%1 , Len=%2").arg(square.get()).arg(length.get()));
-		}
+	// edit already applied to pts; the renderer's series follows it incrementally
+	void pointEdited(const point_edit& edit)
+	{
+		++version;
+		renderer.post(snapshot(), edit);
+	}
 
-		radii = std::move(rad_future.get());
+	void resizeEvent(QResizeEvent*) override
+	{
+		updateCanvas();
 	}
 
 	void paintEvent(QPaintEvent*) override
 	{
 		QPainter painter(this);
-		if (dirty)
-			renderCanvas();
-		painter.drawImage(QPoint{ 0, 0 }, substr);
+		renderer.present(painter);
+		if (show_timings)
+			paintTimings(painter);
 	}
 
-	auto find_point(const BLPoint& test_pt)
+	// stage totals over the last second and the durations of the last frames, newest on the right
+	void paintTimings(QPainter& painter) const
 	{
-		return std::find_if(std::execution::par_unseq, pts.begin(), pts.end(),
-			[&test_pt](auto& pt)
-			{
-				const auto d = pt - test_pt;
-				return (d.x * d.x + d.y * d.y) < sel_tolerance;
-			}
-		);
+		constexpr int history = 120;
+		constexpr double budget_ms = 1000.0 / 60.0;
+		const auto events = trace::events().snapshot(4096);
+		const auto now = trace::now();
+		const auto since = now > 1000000000u ? now - 1000000000u : 0;
+
+		painter.fillRect(QRect(4, 4, 300, 200), QColor(0, 0, 0, 180));
+		painter.setPen(Qt::green);
+		painter.setFont(QFont("monospace", 8));
+		int y = 18;
+		for (const auto& s : trace::summarize(events, since))
+		{
+			painter.drawText(10, y, QString("%1 %2x avg %3 max %4 ms")
+				.arg(QString(s.name))
+				.arg(static_cast<int>(s.count))
+				.arg(QString::number(s.total / 1e6 / s.count, 'f', 2))
+				.arg(QString::number(s.longest / 1e6, 'f', 2)));
+			y += 14;
+		}
+
+		std::vector<std::uint64_t> frames;
+		for (const auto& e : events)
+			if (e.type == trace::kind::complete && std::strcmp(e.name, "frame") == 0)
+				frames.push_back(e.duration);
+		const auto first = frames.size() > history ? frames.size() - history : 0;
+		for (size_t i = first; i < frames.size(); ++i)
+		{
+			// full height of the box is four frame budgets; red above one budget
+			const auto ms = frames[i] / 1e6;
+			const auto h = static_cast<int>(std::min(60.0, ms * 60.0 / (4 * budget_ms)));
+			painter.fillRect(QRect(10 + 2 * static_cast<int>(i - first), 200 - h, 2, h), ms > budget_ms ? QColor(255, 64, 64) : QColor(64, 255, 64));
+		}
 	}
 
 	void mouseDoubleClickEvent(QMouseEvent* event) override
 	{
-		const auto test = find_point(BLPoint(event->pos().x(), event->pos().y()));
+		FOURTD_TRACE_SCOPE("edit.erase");
+		const auto test = grid.find(pts, BLPoint(event->pos().x(), event->pos().y()));
 
-		if (test != pts.end())
+		if (test != point_grid::npos)
 		{
-			pts.erase(test);
-			cur_point = pts.end();
-			updateCoeff();
-			updateCanvas();
+			grid.erase(test, pts[test]);
+			pts.erase(pts.begin() + static_cast<std::ptrdiff_t>(test));
+			cur_point = point_grid::npos;
+			pointEdited({ point_edit::erase, test, {}, {} });
 		}
 	}
 
 	void mousePressEvent(QMouseEvent* event) override
 	{
+		FOURTD_TRACE_SCOPE("edit.press");
 		const BLPoint pt(event->pos().x(), event->pos().y());
-		cur_point = find_point(pt);
-		if (cur_point == pts.end())
 		{
-			const auto inter = f.lengthToPoint({ pt.x,pt.y });
-			if (std::get<2>(inter) < 5)
+			FOURTD_TRACE_SCOPE("hit test");
+			cur_point = grid.find(pts, pt);
+		}
+		if (cur_point == point_grid::npos)
+		{
+			FOURTD_TRACE_SCOPE("lengthToPoint");
+			// the renderer's series may be a few edits behind pts; the index is clamped to them
+			const auto series = renderer.hit_series();
+			const auto inter = series ? series->lengthToPoint({ pt.x,pt.y }) : fourier::closest_point{};
+			if (series && std::get<2>(inter) < 5)
 			{
-				const auto index = static_cast<int>(std::ceil(f.angleToIndex(std::get<0>(inter))));
-				pts.insert(index, pt);
-				cur_point = std::next(pts.begin(), index);
+				const auto index = std::min(pts.size(), static_cast<size_t>(std::max(0.0, std::ceil(series->angleToIndex(std::get<0>(inter))))));
+				pts.insert(pts.begin() + static_cast<std::ptrdiff_t>(index), pt);
+				cur_point = index;
 			}
 			else
 			{
 				pts.push_back(pt);
-				cur_point = std::prev(pts.end());
+				cur_point = pts.size() - 1;
 			}
+			grid.insert(cur_point, pt);
+			pointEdited({ point_edit::insert, cur_point, {}, pt });
 		}
-		updateCoeff();
-		updateCanvas();
 	}
 
 	void mouseReleaseEvent(QMouseEvent*) override
 	{
-		cur_point = pts.end();
+		cur_point = point_grid::npos;
 	}
 
 	void mouseMoveEvent(QMouseEvent* event) override
 	{
 		const BLPoint pt(event->pos().x(), event->pos().y());
-		if (cur_point != pts.end())
+		if (cur_point != point_grid::npos)
 		{
-			*cur_point = pt;
-			updateCoeff();
-			updateCanvas();
+			FOURTD_TRACE_SCOPE("edit.move");
+			const auto from = pts[cur_point];
+			grid.move(cur_point, from, pt);
+			pts[cur_point] = pt;
+			pointEdited({ point_edit::move, cur_point, from, pt });
 		}
 	}
 
 	void showEvent(QShowEvent* event) override
 	{
-		updateCoeff();
+		updateCanvas();
 		QWidget::showEvent(event);
 	}
 
+private:
+	std::vector<BLPoint> pts = pi_symbol;
+	point_grid grid;
+	size_t version = 0;
+	size_t harmonics = fourier::all_harmonics;
+	// index of the dragged point, point_grid::npos when none
+	size_t cur_point = point_grid::npos;
+	bool is_close = true;
+	bool show_circles{};
+	bool show_broken_line{};
+	bool show_tangent{};
+	bool show_normal{};
+	double phase{};
+	bool show_timings{};
+	// last member: its thread is joined before the rest of the widget goes away
+	canvas_renderer renderer;
+};
 
-	void onRenderB2D(BLContext& ctx)
+// Writes an APNG from frames that were encoded as separate PNG files: the IHDR of the first
+// frame and an acTL, then per frame an fcTL and the frame's image data, as IDAT for the first
+// frame and as fdAT after it. Every frame has to have the size of the first one.
+class apng_writer
+{
+public:
+	apng_writer(const std::string& path, std::uint32_t frames, std::uint16_t delay_ms) :
+		out(path, std::ios::binary | std::ios::trunc),
+		frames(frames),
+		delay_ms(delay_ms)
 	{
+	}
 
-		ctx.setFillStyle(BLRgba32(0xFF000000u));
-		ctx.fillAll();
+	bool add(const std::uint8_t* png, size_t size)
+	{
+		static const std::uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (size < sizeof(signature) || std::memcmp(png, signature, sizeof(signature)) != 0)
+			return false;
 
-		if (pts.size() > 1)
+		for (size_t pos = sizeof(signature); pos + 12 <= size; )
 		{
-			if (interp.empty())
-				f.values<BLPoint>(std::back_inserter(interp), 0, pts.size() -1.0 + static_cast<int>(is_close), 0.01);
+			const auto length = read32(png + pos);
+			const auto* type = png + pos + 4;
+			const auto* data = png + pos + 8;
+			if (length > size - pos - 12)
+				return false;
+			pos += 12 + length;
+
+			if (std::memcmp(type, "IHDR", 4) == 0 && length >= 8)
+			{
+				if (index == 0)
+				{
+					out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+					chunk("IHDR", data, length);
+					std::uint8_t actl[8];
+					write32(actl, frames);
+					write32(actl + 4, 0);
+					chunk("acTL", actl, sizeof(actl));
+				}
 
-			ctx.setStrokeStyle(BLRgba32(0xFFFFFF00u));
+				std::uint8_t fctl[26] = {};
+				write32(fctl, sequence++);
+				std::memcpy(fctl + 4, data, 8);
+				fctl[20] = static_cast<std::uint8_t>(delay_ms >> 8);
+				fctl[21] = static_cast<std::uint8_t>(delay_ms);
+				fctl[22] = 1000 >> 8;
+				fctl[23] = 1000 & 0xFF;
+				chunk("fcTL", fctl, sizeof(fctl));
+			}
+			else if (std::memcmp(type, "IDAT", 4) == 0)
+			{
+				if (index == 0)
+				{
+					chunk("IDAT", data, length);
+				}
+				else
+				{
+					scratch.resize(4 + length);
+					write32(scratch.data(), sequence++);
+					std::memcpy(scratch.data() + 4, data, length);
+					chunk("fdAT", scratch.data(), scratch.size());
+				}
+			}
+		}
+		++index;
+		return static_cast<bool>(out);
+	}
 
-			ctx.setStrokeWidth(4);
-			if (is_close)
-				ctx.strokePolygon(&interp[0], interp.size());
-			else
-				ctx.strokePolyline(&interp[0], interp.size());
+	bool finish()
+	{
+		chunk("IEND", nullptr, 0);
+		out.flush();
+		return index == frames && out;
+	}
 
-			if (show_circles || show_tangent || show_normal || show_broken_line)
-			{
-				std::vector<BLPoint> lines;
-				BLPath big_path;
-				BLPath small_path;
-				complex_double der;
+private:
+	static std::uint32_t read32(const std::uint8_t* p)
+	{
+		return std::uint32_t(p[0]) << 24 | std::uint32_t(p[1]) << 16 | std::uint32_t(p[2]) << 8 | p[3];
+	}
 
-				std::list<complex_double> vector_list;
+	static void write32(std::uint8_t* p, std::uint32_t v)
+	{
+		p[0] = static_cast<std::uint8_t>(v >> 24);
+		p[1] = static_cast<std::uint8_t>(v >> 16);
+		p[2] = static_cast<std::uint8_t>(v >> 8);
+		p[3] = static_cast<std::uint8_t>(v);
+	}
 
-				const auto cur_pt = f.nativ_value(f.indexToAngle(pos),
-					[&big_path, &small_path, &lines, &der, &vector_list, r_it = radii.cbegin()](const auto& gsum, const auto& coeff, const complex_double& sincos, size_t k)mutable
-				{
+	// CRC-32 of the PNG specification, over type and data
+	static std::uint32_t crc32(std::uint32_t crc, const std::uint8_t* p, size_t size)
+	{
+		static const auto table = []
+		{
+			std::array<std::uint32_t, 256> t{};
+			for (std::uint32_t n = 0; n < 256; ++n)
+			{
+				auto c = n;
+				for (int k = 0; k < 8; ++k)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[n] = c;
+			}
+			return t;
+		}();
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+		return crc;
+	}
 
-					if (lines.empty())
-						lines.emplace_back(gsum.real(), gsum.imag());
+	void chunk(const char* type, const std::uint8_t* data, size_t size)
+	{
+		std::uint8_t word[4];
+		write32(word, static_cast<std::uint32_t>(size));
+		out.write(reinterpret_cast<const char*>(word), 4);
+		out.write(type, 4);
+		if (size)
+			out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+		auto crc = crc32(0xFFFFFFFFu, reinterpret_cast<const std::uint8_t*>(type), 4);
+		crc = crc32(crc, data, size) ^ 0xFFFFFFFFu;
+		write32(word, crc);
+		out.write(reinterpret_cast<const char*>(word), 4);
+	}
 
-					auto sum = gsum;
+	std::ofstream out;
+	std::uint32_t frames;
+	std::uint16_t delay_ms;
+	std::uint32_t sequence = 0;
+	std::uint32_t index = 0;
+	std::vector<std::uint8_t> scratch;
+};
 
-					const auto z1 = r_it->first * sincos;
-					const auto z2 = r_it->second * std::conj(sincos);
+struct export_options
+{
+	std::string dir;
+	std::string curve;
+	size_t frames = 100;
+	int width = 800;
+	int height = 600;
+	int fps = 10;
+	canvas_state state;
+};
 
-					vector_list.push_front(z2);
-					vector_list.push_back(z1);
+bool parseExport(int argc, char* argv[], export_options& opt)
+{
+	opt.state.show_circles = true;
+	opt.state.show_broken_line = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const auto eq = arg.find('=');
+		const auto key = arg.substr(0, eq);
+		const auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+		if (key == "--export" && !value.empty())
+			opt.dir = value;
+		else if (key == "--frames" && std::atoi(value.c_str()) > 0)
+			opt.frames = static_cast<size_t>(std::atoi(value.c_str()));
+		else if (key == "--size" && std::sscanf(value.c_str(), "%dx%d", &opt.width, &opt.height) == 2 && opt.width > 0 && opt.height > 0)
+			continue;
+		else if (key == "--fps" && std::atoi(value.c_str()) > 0)
+			opt.fps = std::atoi(value.c_str());
+		else if (key == "--open")
+			opt.state.is_close = false;
+		else if (key == "--no-circles")
+			opt.state.show_circles = false;
+		else if (key == "--no-zigzag")
+			opt.state.show_broken_line = false;
+		else if (key == "--tangent")
+			opt.state.show_tangent = true;
+		else if (key == "--normal")
+			opt.state.show_normal = true;
+		else if (arg[0] != '-' && opt.curve.empty())
+			opt.curve = arg;
+		else
+		{
+			std::fprintf(stderr, "usage: fourier --export=<dir> [--frames=<n>] [--size=<w>x<h>] [--fps=<n>] [--open] [--no-circles] [--no-zigzag] [--tangent] [--normal] [<coefficient file>]\n");
+			return false;
+		}
+	}
+	return true;
+}
 
-					der = fourier::derivative_step(der, coeff, sincos, k);
-					++r_it;
-				}
-				);
+// Renders the tracer going once round the curve without a window. The curve layer is drawn once;
+// frames are then drawn in batches of one per worker of the shared pool, each worker with its own
+// image and overlay_painter, and encoded to PNG by Blend2D. The batch is written in order as
+// frame_NNNN.png and appended to the APNG animation.png. The curve's bounding box, with a margin,
+// is scaled to fill the frame.
+int exportAnimation(int argc, char* argv[])
+{
+	export_options opt;
+	if (!parseExport(argc, argv, opt))
+		return 1;
+
+	auto& state = opt.state;
+	state.pts = pi_symbol;
+	fourier f(state.pts.cbegin(), state.pts.cend());
+	if (!opt.curve.empty() && !loadCurve(opt.curve, f, state.pts))
+	{
+		std::fprintf(stderr, "fourier: cannot read coefficient file %s\n", opt.curve.c_str());
+		return 1;
+	}
+	if (state.pts.size() < 2)
+	{
+		std::fprintf(stderr, "fourier: %s has fewer than two samples, nothing to animate\n", opt.curve.c_str());
+		return 1;
+	}
+	state.size = QSize(opt.width, opt.height);
 
-				complex_double sum= f.firstCoeff();
-				for (const auto &vec : vector_list)
-				{
-					big_path.addCircle(BLCircle(sum.real(), sum.imag(), std::abs(vec)));
-					sum += vec;
-					lines.emplace_back(sum.real(), sum.imag());
-					small_path.addCircle(BLCircle(sum.real(), sum.imag(), 2));
-				}
+	std::error_code ec;
+	std::filesystem::create_directories(opt.dir, ec);
+	const std::filesystem::path dir(opt.dir);
 
-				if (show_circles)
-				{
-					ctx.setStrokeWidth(2);
-					ctx.setStrokeStyle(BLRgba32(0xF000B3B3u));
-					ctx.strokePath(big_path);
-				}
+	double x0 = state.pts.front().x, x1 = x0, y0 = state.pts.front().y, y1 = y0;
+	for (const auto& pt : state.pts)
+	{
+		x0 = std::min(x0, pt.x);
+		x1 = std::max(x1, pt.x);
+		y0 = std::min(y0, pt.y);
+		y1 = std::max(y1, pt.y);
+	}
+	const double margin = 0.1 * std::max({ x1 - x0, y1 - y0, 1.0 });
+	const double scale = std::min(opt.width / (x1 - x0 + 2 * margin), opt.height / (y1 - y0 + 2 * margin));
+	const double dx = (opt.width - (x0 + x1) * scale) / 2;
+	const double dy = (opt.height - (y0 + y1) * scale) / 2;
 
-				ctx.setStrokeWidth(1);
+	const auto radii = radiiOf(f);
+	// the arc length table is built here once instead of by the first frames at the same time
+	f.totalLength();
 
-				if (show_broken_line)
-				{
-					ctx.setStrokeWidth(2);
-					ctx.setStrokeStyle(BLRgba32(0xFFFFFFFFu));
-					ctx.setFillStyle(BLRgba32(0xFFFFFFFFu));
-					ctx.strokePolyline(&lines[0], lines.size());
-					ctx.fillPath(small_path);
-				}
+	BLImage layer(opt.width, opt.height, BL_FORMAT_PRGB32);
+	{
+		std::vector<BLPoint> interp;
+		BLContext ctx(layer);
+		ctx.translate(dx, dy);
+		ctx.scale(scale);
+		paintLayer(ctx, f, state, render_tolerance / scale, interp);
+		ctx.end();
+	}
 
-				ctx.setStrokeWidth(1);
-				ctx.setStrokeStyle(BLRgba32(0xFFFF0000u));
+	BLImageCodec png;
+	png.findByName("PNG");
 
-				if (show_tangent)
-					ctx.strokeLine(cur_pt.real() - der.real(),cur_pt.imag() - der.imag(),cur_pt.real() + der.real(),cur_pt.imag() + der.imag());
+	struct frame_slot
+	{
+		BLImage image;
+		overlay_painter overlay;
+		BLArray<uint8_t> encoded;
+		bool ok = false;
+	};
 
-				if (show_normal)
-					ctx.strokeLine(cur_pt.real() - der.imag(),cur_pt.imag() + der.real(), cur_pt.real() + der.imag(),cur_pt.imag() - der.real());
-				ctx.setStrokeWidth(3);
-				ctx.strokeCircle(lines.back().x, lines.back().y, 4);
-			}
-		}
+	auto& pool = thread_pool::shared();
+	std::vector<frame_slot> slots(pool.size() + 1);
+	for (auto& slot : slots)
+	{
+		slot.image.create(opt.width, opt.height, BL_FORMAT_PRGB32);
+		slot.overlay.reserve(radii.size());
+	}
 
-		BLPath path;
+	apng_writer animation((dir / "animation.png").string(), static_cast<std::uint32_t>(opt.frames), static_cast<std::uint16_t>(1000 / opt.fps));
+	for (size_t first = 0; first < opt.frames; first += slots.size())
+	{
+		const auto last = std::min(opt.frames, first + slots.size());
+		pool.parallel_for(first, last, [&](size_t i, size_t end)
+			{
+				for (; i != end; ++i)
+				{
+					auto& slot = slots[i - first];
+					auto frame = state;
+					frame.phase = static_cast<double>(i) / static_cast<double>(opt.frames);
+
+					BLContext ctx(slot.image);
+					ctx.setCompOp(BL_COMP_OP_SRC_COPY);
+					ctx.blitImage(BLPoint(0, 0), layer);
+					ctx.setCompOp(BL_COMP_OP_SRC_OVER);
+					ctx.translate(dx, dy);
+					ctx.scale(scale);
+					slot.overlay.paint(ctx, f, radii, frame);
+					ctx.end();
+					slot.ok = slot.image.writeToData(slot.encoded, png) == BL_SUCCESS;
+				}
+			}
+		);
 
-		for (const auto& pt : pts)
+		for (size_t i = first; i < last; ++i)
 		{
-			path.addCircle(BLCircle(pt.x, pt.y, 3));
+			const auto& slot = slots[i - first];
+			char name[32];
+			std::snprintf(name, sizeof(name), "frame_%04zu.png", i);
+			std::ofstream file(dir / name, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(slot.encoded.data()), static_cast<std::streamsize>(slot.encoded.size()));
+			if (!slot.ok || !file || !animation.add(slot.encoded.data(), slot.encoded.size()))
+			{
+				std::fprintf(stderr, "fourier: cannot write frame %zu to %s\n", i, opt.dir.c_str());
+				return 1;
+			}
 		}
-		ctx.setFillStyle(BLRgba32(0xFFFFFFFFu));
-		ctx.fillPath(path);
 	}
-
-
-private:
-	BLImage blImage;
-	QImage substr;
-	QList<BLPoint> pts = pi_symbol;
-	fourier f;
-	QList<BLPoint>::iterator cur_point = pts.end();
-	std::vector<BLPoint> interp;
-	std::vector<std::pair<complex_double, complex_double>> radii;
-	bool is_close = true;
-	bool show_circles{};
-	bool show_broken_line{};
-	bool show_tangent{};
-	bool show_normal{};
-	BLContextCreateInfo createInfo{};
-	double pos{};
-};
+	if (!animation.finish())
+	{
+		std::fprintf(stderr, "fourier: cannot write %s\n", (dir / "animation.png").string().c_str());
+		return 1;
+	}
+	return 0;
+}
 
 int main(int argc, char* argv[])
 {
+	// --export renders the animation offscreen and never opens a window
+	for (int i = 1; i < argc; ++i)
+		if (std::strncmp(argv[i], "--export=", 9) == 0)
+			return exportAnimation(argc, argv);
+
 	QApplication app(argc, argv);
 	QWidget win;
 
@@ -406,9 +1235,12 @@ int main(int argc, char* argv[])
 	auto* show_normal = new QCheckBox("Normal");
 
 	auto* anima = new QCheckBox("Animation");
+
 	auto* positin = new QDial();
 	positin->setWrapping(true);
 	auto* canvas = new QCanvasWidget;
+	if (argc > 1 && !canvas->load(argv[1]))
+		qWarning("fourier: cannot read coefficient file %s", argv[1]);
 
 	QTimer timer;
 	QObject::connect(&timer, &QTimer::timeout, [positin]
@@ -427,6 +1259,23 @@ int main(int argc, char* argv[])
 	l->addWidget(show_normal);
 	l->addWidget(anima);
 	l->addWidget(positin);
+	// the timing controls exist only in builds that record traces
+	if (trace::enabled)
+	{
+		auto* show_timings = new QCheckBox("Timings");
+		auto* export_trace = new QPushButton("Export trace");
+		l->addWidget(show_timings);
+		l->addWidget(export_trace);
+
+		QObject::connect(show_timings, &QCheckBox::toggled, canvas, &QCanvasWidget::setShowTimings);
+		QObject::connect(export_trace, &QPushButton::pressed, [canvas]
+			{
+				const auto path = QFileDialog::getSaveFileName(canvas, "Export trace", "fourier.trace.json", "Chrome trace (*.json)");
+				if (!path.isEmpty() && !canvas->exportTrace(path.toStdString()))
+					qWarning("fourier: cannot write %s", qPrintable(path));
+			}
+		);
+	}
 	l->addStretch();
 	h->addLayout(l);
 	h->addWidget(canvas, 1);
@@ -0,0 +1,202 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "trinterp.hpp"
+
+namespace fourtd
+{
+	namespace detail
+	{
+		// X_k <- (X_k + d) * e^(2*pi*i*k/W) for every tracked bin; staged through local
+		// blocks so the loops vectorize without alias checks
+		FOURTD_TARGET_CLONES
+		inline void slide_bins(double* xr, double* xi, const double* tr, const double* ti, size_t count, double dr, double di) noexcept
+		{
+			double r[batch_width], i[batch_width];
+			size_t k = 0;
+			for (; k + batch_width <= count; k += batch_width)
+			{
+				for (size_t j = 0; j < batch_width; ++j)
+				{
+					r[j] = xr[k + j] + dr;
+					i[j] = xi[k + j] + di;
+				}
+				for (size_t j = 0; j < batch_width; ++j)
+				{
+					xr[k + j] = r[j] * tr[k + j] - i[j] * ti[k + j];
+					xi[k + j] = r[j] * ti[k + j] + i[j] * tr[k + j];
+				}
+			}
+			for (; k < count; ++k)
+			{
+				const double rk = xr[k] + dr;
+				const double ik = xi[k] + di;
+				xr[k] = rk * tr[k] - ik * ti[k];
+				xi[k] = rk * ti[k] + ik * tr[k];
+			}
+		}
+	}
+
+	// Series over the last W samples of a stream. push() slides the DFT of the window by one
+	// sample, X_k <- (X_k - oldest + newest) * e^(2*pi*i*k/W), for the bins of the kept harmonics
+	// only: O(M) per sample. The coefficients are converted from the bins on first use after a
+	// push, and every resync_period pushes the bins are recomputed from the window by FFT so the
+	// rounding of the twiddle products cannot accumulate.
+	//
+	// One thread at a time: series() converts in place and returns a reference that the next push
+	// invalidates, so a reader on another thread needs the writer's lock around both.
+	class sliding_fourier
+	{
+		sliding_fourier(const sliding_fourier&) = delete;
+		sliding_fourier& operator =(const sliding_fourier&) = delete;
+
+	public:
+		// 0 picks max(4096, 16*W) pushes, which keeps the FFT below a few percent of the work
+		static constexpr size_t default_resync_period = 0;
+
+		// window of zeros
+		explicit sliding_fourier(size_t window, size_t max_harmonics = fourier::all_harmonics, size_t resync_period = default_resync_period) :
+			sliding_fourier(std::vector<complex_double>(std::max<size_t>(1, window)), max_harmonics, resync_period)
+		{
+		}
+
+		template<class _FwdIt>
+		sliding_fourier(_FwdIt _First, _FwdIt _Last, size_t max_harmonics = fourier::all_harmonics, size_t resync_period = default_resync_period) :
+			sliding_fourier(to_samples(_First, _Last), max_harmonics, resync_period)
+		{
+		}
+
+		void push(const complex_double& sample)
+		{
+			auto& oldest = samples[head];
+			const auto d = sample - oldest;
+			energy += std::norm(sample) - std::norm(oldest);
+			oldest = sample;
+			head = head + 1 == samples.size() ? 0 : head + 1;
+
+			if (++pushes == resync_period)
+				resync();
+			else
+				detail::slide_bins(xr.data(), xi.data(), tr.data(), ti.data(), bins.size(), d.real(), d.imag());
+			dirty = true;
+		}
+
+		template<class _FwdIt> void push(_FwdIt _First, _FwdIt _Last)
+		{
+			for (; _First != _Last; ++_First)
+				push(detail::to_complex<double>(*_First));
+		}
+
+		// recomputes the tracked bins from the window: O(W log W)
+		void resync()
+		{
+			for (size_t j = 0; j < samples.size(); ++j)
+				scratch[j] = samples[(head + j) % samples.size()];
+			plan->forward(scratch.data());
+			for (size_t b = 0; b < bins.size(); ++b)
+			{
+				xr[b] = scratch[bins[b]].real();
+				xi[b] = scratch[bins[b]].imag();
+			}
+			energy = 0.0;
+			for (const auto& z : samples)
+				energy += std::norm(z);
+			pushes = 0;
+			dirty = true;
+		}
+
+		size_t window() const noexcept
+		{
+			return samples.size();
+		}
+
+		// series of the window, oldest sample first: O(M) after a push, free otherwise
+		const fourier& series() const
+		{
+			if (dirty)
+			{
+				for (size_t b = 0; b < bins.size(); ++b)
+					scratch[bins[b]] = { xr[b], xi[b] };
+
+				auto& f = *current;
+				f.ab.clear();
+				f.square_value = -1.0; //reset;
+				f.sample_energy = energy / static_cast<double>(samples.size());
+				f.assign_spectrum(scratch, f.harmonic_limit);
+				f.coeffs_changed();
+				dirty = false;
+			}
+			return *current;
+		}
+
+		const auto& coeffs() const
+		{
+			return series().coeffs();
+		}
+
+		const auto& firstCoeff() const
+		{
+			return series().firstCoeff();
+		}
+
+		double square() const
+		{
+			return series().square();
+		}
+
+	private:
+		template<class _FwdIt> static std::vector<complex_double> to_samples(_FwdIt _First, _FwdIt _Last)
+		{
+			std::vector<complex_double> result;
+			for (; _First != _Last; ++_First)
+				result.push_back(detail::to_complex<double>(*_First));
+			if (result.empty())
+				result.resize(1);
+			return result;
+		}
+
+		sliding_fourier(std::vector<complex_double>&& window, size_t max_harmonics, size_t resync_period) :
+			samples(window),
+			resync_period(resync_period != 0 ? resync_period : std::max<size_t>(4096, 16 * samples.size())),
+			current(new fourier(std::move(window), max_harmonics)),
+			scratch(samples.size())
+		{
+			// bins read by fourier::assign_spectrum: 0, k and W-k for the kept harmonics, W/2 for the Nyquist term
+			const auto w = samples.size();
+			const auto harmonics = current->coeffs().size();
+			bins.push_back(0);
+			for (size_t k = 1; k <= harmonics; ++k)
+			{
+				bins.push_back(k);
+				if (2 * k != w)
+					bins.push_back(w - k);
+			}
+			for (const auto bin : bins)
+			{
+				const auto twiddle = std::polar(1.0, 2 * pi * static_cast<double>(bin) / static_cast<double>(w));
+				tr.push_back(twiddle.real());
+				ti.push_back(twiddle.imag());
+			}
+			xr.resize(bins.size());
+			xi.resize(bins.size());
+
+			plan = current->plan ? current->plan : std::make_shared<const fft_plan>(w);
+			resync();
+		}
+
+		// ring buffer, oldest sample at head
+		std::vector<complex_double> samples;
+		size_t head = 0;
+		size_t pushes = 0;
+		const size_t resync_period;
+		double energy = 0.0;
+
+		std::vector<size_t> bins;
+		std::vector<double> xr, xi, tr, ti;
+
+		std::unique_ptr<fourier> current;
+		std::shared_ptr<const fft_plan> plan;
+		mutable std::vector<complex_double> scratch;
+		mutable bool dirty = true;
+	};
+}
@@ -0,0 +1,884 @@
+// Checks the fast paths of the series against a direct O(N*M) evaluation or a brute-force
+// recompute, each within a tolerance.
+//
+//   fourier_tests          exits with the number of failed checks
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "trinterp.hpp"
+#include "thread_pool.hpp"
+#include "sliding_fourier.hpp"
+#include "fourier_batch.hpp"
+#include "coeff_file.hpp"
+#include "fixed_fourier.hpp"
+
+using namespace fourtd;
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool ok, const std::string& what, double error = 0.0)
+	{
+		if (ok) return;
+		++failures;
+		std::fprintf(stderr, "FAILED: %s (error %g)\n", what.c_str(), error);
+	}
+
+	void check_close(double error, double tolerance, const std::string& what)
+	{
+		check(error <= tolerance, what, error);
+	}
+
+	// closed contour with a few harmonics and some noise
+	std::vector<complex_double> contour(size_t n, unsigned seed = 1)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<double> noise(-1.0, 1.0);
+		std::vector<complex_double> pts(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const auto t = 2 * pi * static_cast<double>(i) / static_cast<double>(n);
+			pts[i] = std::polar(200.0, t) + std::polar(40.0, 5 * t) + std::polar(10.0, -11 * t) + complex_double(noise(rng), noise(rng));
+		}
+		return pts;
+	}
+
+	// a0 + sum_k a_k*cos(k*angle) + b_k*sin(k*angle), every term from std::cos and std::sin
+	template<class Coeff> complex_double direct_value(const complex_double& a0, const std::vector<Coeff>& ab, double angle)
+	{
+		auto sum = a0;
+		for (size_t k = 0; k < ab.size(); ++k)
+		{
+			const auto t = static_cast<double>(k + 1) * angle;
+			sum += ab[k].first * std::cos(t) + ab[k].second * std::sin(t);
+		}
+		return sum;
+	}
+
+	// d/dangle of direct_value
+	template<class Coeff> complex_double direct_derivative(const std::vector<Coeff>& ab, double angle)
+	{
+		complex_double sum;
+		for (size_t k = 0; k < ab.size(); ++k)
+		{
+			const auto h = static_cast<double>(k + 1);
+			sum += h * (ab[k].second * std::cos(h * angle) - ab[k].first * std::sin(h * angle));
+		}
+		return sum;
+	}
+
+	double coeff_error(const fourier& a, const fourier& b)
+	{
+		if (a.coeffs().size() != b.coeffs().size())
+			return HUGE_VAL;
+		auto error = std::abs(a.firstCoeff() - b.firstCoeff());
+		for (size_t k = 0; k < a.coeffs().size(); ++k)
+		{
+			error = std::max(error, std::abs(a.coeffs()[k].first - b.coeffs()[k].first));
+			error = std::max(error, std::abs(a.coeffs()[k].second - b.coeffs()[k].second));
+		}
+		return error;
+	}
+
+	// count angles over two periods, starting below zero
+	std::vector<double> test_angles(size_t count)
+	{
+		std::vector<double> angles(count);
+		for (size_t i = 0; i < count; ++i)
+			angles[i] = -pi + 4 * pi * static_cast<double>(i) / static_cast<double>(count);
+		return angles;
+	}
+
+	// polyline through count + 1 equispaced points of the indices [a, b]
+	double brute_length(const fourier& f, double a, double b, size_t count)
+	{
+		std::vector<double> angles(count + 1);
+		for (size_t i = 0; i <= count; ++i)
+			angles[i] = f.indexToAngle(a + (b - a) * static_cast<double>(i) / static_cast<double>(count));
+		std::vector<complex_double> values(angles.size());
+		f.nativ_values(angles.data(), angles.size(), values.data());
+		double sum = 0.0;
+		for (size_t i = 0; i < count; ++i)
+			sum += std::abs(values[i + 1] - values[i]);
+		return sum;
+	}
+
+	// the polyline falls short by O(h^2); one Richardson step removes that term
+	double reference_length(const fourier& f, double a, double b, size_t count)
+	{
+		return (4 * brute_length(f, a, b, 2 * count) - brute_length(f, a, b, count)) / 3;
+	}
+
+	// sample counts worth covering: tiny, odd, prime, power of two, composite
+	const size_t sizes[] = { 1, 2, 3, 7, 16, 17, 64, 97, 100, 128, 1000, 1021 };
+
+	void fft_fit()
+	{
+		for (const auto n : sizes)
+		{
+			const auto pts = contour(n);
+			fourier direct(pts.cbegin(), pts.cend()), fft(pts.cbegin(), pts.cend());
+			direct.calcul_coeff(pts.cbegin(), pts.cend(), fourier::coeff_method::direct);
+			fft.calcul_coeff(pts.cbegin(), pts.cend(), fourier::coeff_method::fft);
+			const auto name = " n=" + std::to_string(n);
+			check_close(coeff_error(direct, fft), 1e-9, "fft coefficients match the direct sum" + name);
+
+			// interpolation: the series passes through every sample
+			double error = 0.0;
+			for (size_t i = 0; i < n; ++i)
+				error = std::max(error, std::abs(fft.value(static_cast<double>(i)) - pts[i]));
+			check_close(error, 1e-9, "fft series interpolates the samples" + name);
+		}
+	}
+
+	void point_edits()
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<double> coord(-300.0, 300.0);
+		for (const auto n : { size_t(16), size_t(17), size_t(100), size_t(101) })
+		{
+			const auto name = " n=" + std::to_string(n);
+			auto pts = contour(n, 3);
+			fourier f(pts.cbegin(), pts.cend());
+			for (int step = 0; step < 50; ++step)
+			{
+				const auto index = rng() % n;
+				const complex_double value(coord(rng), coord(rng));
+				f.update_point(index, pts[index], value);
+				pts[index] = value;
+			}
+			const fourier refit(pts.cbegin(), pts.cend());
+			check_close(coeff_error(f, refit), 1e-9, "update_point matches a refit" + name);
+			check_close(std::abs(f.square() - refit.square()), 1e-9 * refit.square(), "update_point keeps square()" + name);
+
+			const auto back = f.samples();
+			double error = back.size() == n ? 0.0 : HUGE_VAL;
+			for (size_t i = 0; i < back.size(); ++i)
+				error = std::max(error, std::abs(back[i] - pts[i]));
+			check_close(error, 1e-9, "samples() recovers the moved samples" + name);
+
+			const complex_double value(12.5, -3.0);
+			const auto index = n / 3;
+			f.insert_point(index, value);
+			pts.insert(pts.begin() + static_cast<std::ptrdiff_t>(index), value);
+			check_close(coeff_error(f, fourier(pts.cbegin(), pts.cend())), 1e-9, "insert_point matches a refit" + name);
+
+			f.erase_point(0);
+			pts.erase(pts.begin());
+			check_close(coeff_error(f, fourier(pts.cbegin(), pts.cend())), 1e-9, "erase_point matches a refit" + name);
+		}
+	}
+
+	void evaluation()
+	{
+		for (const auto n : { size_t(5), size_t(17), size_t(128) })
+		{
+			const auto pts = contour(n);
+			const fourier f(pts.cbegin(), pts.cend());
+			const auto name = " n=" + std::to_string(n);
+
+			// counts around the batch width exercise the partial last batch
+			for (const size_t count : { size_t(1), size_t(15), size_t(16), size_t(17), size_t(1000) })
+			{
+				const auto angles = test_angles(count);
+				std::vector<complex_double> batch(count);
+				f.nativ_values(angles.data(), count, batch.data());
+				double scalar_error = 0.0, batch_error = 0.0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					const auto expected = direct_value(f.firstCoeff(), f.coeffs(), angles[i]);
+					scalar_error = std::max(scalar_error, std::abs(f.nativ_value(angles[i]) - expected));
+					batch_error = std::max(batch_error, std::abs(batch[i] - expected));
+				}
+				const auto counted = name + " count=" + std::to_string(count);
+				check_close(scalar_error, 1e-9, "nativ_value matches the direct sum" + counted);
+				check_close(batch_error, 1e-9, "nativ_values matches the direct sum" + counted);
+			}
+
+			std::vector<complex_double> values;
+			const double a = 0.5, b = static_cast<double>(n), delta = 0.37;
+			f.values<complex_double>(std::back_inserter(values), a, b, delta);
+			check(values.size() == static_cast<size_t>(std::ceil((b - a) / delta)), "values() count" + name);
+			double error = 0.0;
+			for (size_t i = 0; i < values.size(); ++i)
+				error = std::max(error, std::abs(values[i] - direct_value(f.firstCoeff(), f.coeffs(), f.indexToAngle(a + static_cast<double>(i) * delta))));
+			check_close(error, 1e-9, "values() matches the direct sum" + name);
+		}
+	}
+
+	void dense_values()
+	{
+		for (const auto n : { size_t(7), size_t(128), size_t(1000) })
+		{
+			const auto pts = contour(n);
+			const fourier f(pts.cbegin(), pts.cend());
+			const auto name = " n=" + std::to_string(n);
+
+			// fewer outputs than harmonics fold the spectrum; more pad it. 3*2^11 splits into three
+			// radix-2 grids, the others take one transform of the whole count
+			for (const size_t count : { size_t(1), size_t(3), n, 2 * n + 1, size_t(5000), size_t(3) << 11 })
+			{
+				const auto resampled = f.resample(count);
+				double error = resampled.size() == count ? 0.0 : HUGE_VAL;
+				for (size_t m = 0; m < resampled.size(); ++m)
+				{
+					const auto index = static_cast<double>(m) * static_cast<double>(n) / static_cast<double>(count);
+					error = std::max(error, std::abs(resampled[m] - direct_value(f.firstCoeff(), f.coeffs(), f.indexToAngle(index))));
+				}
+				check_close(error, 1e-8, "resample matches the direct sum" + name + " count=" + std::to_string(count));
+			}
+
+			// two periods at a step that divides the period, long enough to take the inverse FFT
+			std::vector<complex_double> values;
+			const double delta = 0.1;
+			f.values<complex_double>(std::back_inserter(values), 0.0, 2.0 * static_cast<double>(n), delta);
+			check(values.size() == 20 * n, "dense values() count" + name);
+			double error = 0.0;
+			for (size_t i = 0; i < values.size(); ++i)
+				error = std::max(error, std::abs(values[i] - direct_value(f.firstCoeff(), f.coeffs(), f.indexToAngle(static_cast<double>(i) * delta))));
+			check_close(error, 1e-8, "dense values() matches the direct sum" + name);
+		}
+	}
+
+	void long_series()
+	{
+		// a thousand harmonics walk the rotation well past many re-anchoring points
+		const size_t n = 2001;
+		const auto pts = contour(n);
+		const fourier f(pts.cbegin(), pts.cend());
+		const auto angles = test_angles(200);
+
+		std::vector<complex_double> batch(angles.size());
+		f.nativ_values(angles.data(), angles.size(), batch.data());
+		double value_error = 0.0, batch_error = 0.0, derivative_error = 0.0;
+		for (size_t i = 0; i < angles.size(); ++i)
+		{
+			const auto expected = direct_value(f.firstCoeff(), f.coeffs(), angles[i]);
+			value_error = std::max(value_error, std::abs(f.nativ_value(angles[i]) - expected));
+			batch_error = std::max(batch_error, std::abs(batch[i] - expected));
+			const auto index = f.angleToIndex(angles[i]);
+			derivative_error = std::max(derivative_error, std::abs(f.derivative_value(index) - direct_derivative(f.coeffs(), angles[i])));
+		}
+		check_close(value_error, 1e-9, "nativ_value over 1000 harmonics matches the direct sum");
+		check_close(batch_error, 1e-9, "nativ_values over 1000 harmonics matches the direct sum");
+		check_close(derivative_error, 1e-7, "derivative_value over 1000 harmonics matches the direct sum");
+	}
+
+	void pool()
+	{
+		thread_pool workers(3);
+
+		// every index is visited exactly once, also from parallel_for calls nested in a task
+		const size_t outer = 8, inner = 1000;
+		std::vector<std::atomic<int>> visits(outer * inner);
+		workers.parallel_for(0, outer, [&workers, &visits](size_t first, size_t last)
+			{
+				for (; first != last; ++first)
+				{
+					const auto base = first * inner;
+					workers.parallel_for(base, base + inner, [&visits](size_t a, size_t b)
+						{
+							for (; a != b; ++a)
+								++visits[a];
+						}
+					);
+				}
+			}
+		);
+		check(std::all_of(visits.cbegin(), visits.cend(), [](const std::atomic<int>& v) { return v == 1; }), "nested parallel_for visits every index once");
+
+		// the first exception of any chunk reaches the caller once all chunks are done
+		std::atomic<size_t> done{ 0 };
+		bool thrown = false;
+		try
+		{
+			workers.parallel_for(0, 100, [&done](size_t first, size_t last)
+				{
+					done += last - first;
+					if (first <= 50 && 50 < last)
+						throw std::runtime_error("chunk failed");
+				}
+			);
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		check(thrown, "parallel_for rethrows a chunk's exception");
+		check(done == 100, "parallel_for finishes the other chunks before rethrowing");
+
+		auto failed = workers.submit([]() -> int { throw std::logic_error("task failed"); });
+		thrown = false;
+		try
+		{
+			failed.get();
+		}
+		catch (const std::logic_error&)
+		{
+			thrown = true;
+		}
+		check(thrown, "submit hands a task's exception to its future");
+		check(workers.submit([] { return 42; }).get() == 42, "the pool keeps running after exceptions");
+	}
+
+	void arc_length()
+	{
+		for (const auto n : { size_t(16), size_t(100), size_t(257), size_t(1000) })
+		{
+			const auto pts = contour(n);
+			const fourier f(pts.cbegin(), pts.cend());
+			const auto name = " n=" + std::to_string(n);
+			const auto full = static_cast<double>(n);
+
+			// whole periods, a part of one, and a span over the period boundary
+			for (const auto& range : { std::make_pair(0.0, full), std::make_pair(0.3, 0.4 * full), std::make_pair(-0.7 * full, 1.2 * full) })
+			{
+				const auto expected = reference_length(f, range.first, range.second, size_t(1) << (n < 1000 ? 18 : 16));
+				const auto where = name + " [" + std::to_string(range.first) + ", " + std::to_string(range.second) + "]";
+				if (n < 1000)
+					check_close(std::abs(f.length(range.first, range.second, 0.0, 1e-10) - expected), 1e-9 * expected, "length matches the polyline" + where);
+				check_close(std::abs(f.length(range.first, range.second, 0.0, 1e-6) - expected), 1e-6 * expected, "length within rel_eps" + where);
+				check_close(std::abs(f.length(range.first, range.second) - expected), 0.1, "length within the default eps" + where);
+			}
+		}
+	}
+
+	void arc_table()
+	{
+		for (const auto n : { size_t(5), size_t(100), size_t(257) })
+		{
+			const auto pts = contour(n);
+			const fourier f(pts.cbegin(), pts.cend());
+			const auto name = " n=" + std::to_string(n);
+			const auto full = static_cast<double>(n);
+			const auto count = size_t(1) << 16;
+			const auto total = reference_length(f, 0.0, full, count);
+			check_close(std::abs(f.totalLength() - total), 1e-7 * total, "totalLength matches the polyline" + name);
+
+			double length_error = 0.0, inverse_error = 0.0;
+			for (const auto idx : { 0.0, 0.25, 0.37 * full, full - 1e-3, 1.5 * full, -0.4 * full })
+			{
+				const auto expected = idx >= 0.0 ? reference_length(f, 0.0, idx, count) : -reference_length(f, idx, 0.0, count);
+				const auto length = f.lengthAtParameter(idx);
+				length_error = std::max(length_error, std::abs(length - expected));
+				inverse_error = std::max(inverse_error, std::abs(f.parameterAtLength(length) - idx));
+			}
+			check_close(length_error, 1e-6 * total, "lengthAtParameter matches the polyline" + name);
+			check_close(inverse_error, 1e-8 * full, "parameterAtLength inverts lengthAtParameter" + name);
+		}
+	}
+
+	void closest_point()
+	{
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<double> coord(-400.0, 400.0);
+		for (const auto n : { size_t(7), size_t(100), size_t(257) })
+		{
+			const auto pts = contour(n);
+			const fourier f(pts.cbegin(), pts.cend());
+			const auto name = " n=" + std::to_string(n);
+
+			// exhaustive search over a dense sampling; the true minimum lies at most one chord below it
+			const size_t count = size_t(1) << 16;
+			const auto dense = f.resample(count);
+			double chord = 0.0;
+			for (size_t i = 0; i < count; ++i)
+				chord = std::max(chord, std::abs(dense[(i + 1) % count] - dense[i]));
+
+			std::vector<complex_double> tests;
+			for (int i = 0; i < 100; ++i)
+				tests.emplace_back(coord(rng), coord(rng));
+			for (size_t i = 0; i < n; ++i)
+				tests.push_back(pts[i]);
+			tests.emplace_back(5000.0, -3000.0);
+
+			const auto batch = f.lengthToPoints(tests);
+			double error = 0.0, consistency = 0.0;
+			for (size_t t = 0; t < tests.size(); ++t)
+			{
+				double nearest = HUGE_VAL;
+				for (const auto& z : dense)
+					nearest = std::min(nearest, std::abs(z - tests[t]));
+				const auto [angle, value, distance] = f.lengthToPoint(tests[t]);
+				error = std::max(error, std::max(distance - nearest, nearest - chord - distance));
+				consistency = std::max(consistency, std::abs(value - f.nativ_value(angle)) + std::abs(distance - std::abs(value - tests[t])));
+				consistency = std::max(consistency, std::abs(std::get<2>(batch[t]) - distance));
+			}
+			check_close(error, 1e-9, "lengthToPoint finds the exhaustive minimum" + name);
+			check_close(consistency, 1e-9, "lengthToPoint returns a consistent angle, value and distance" + name);
+		}
+	}
+
+	void jets()
+	{
+		for (const auto n : { size_t(17), size_t(100), size_t(601) })
+		{
+			const auto pts = contour(n);
+			const fourier f(pts.cbegin(), pts.cend());
+			const auto name = " n=" + std::to_string(n);
+			const auto angles = test_angles(100);
+			const auto value = [&f](double angle) { return direct_value(f.firstCoeff(), f.coeffs(), angle); };
+
+			std::vector<fourier::jet> batch(angles.size());
+			f.nativ_jets(angles.data(), angles.size(), batch.data());
+			double value_error = 0.0, first_error = 0.0, second_error = 0.0, curvature_error = 0.0, batch_error = 0.0;
+			double first_scale = 0.0, second_scale = 0.0;
+			for (size_t i = 0; i < angles.size(); ++i)
+			{
+				// fourth-order central differences of the direct sum
+				const double h = 0.05 / static_cast<double>(n);
+				const auto t = angles[i];
+				const auto p1 = value(t + h), m1 = value(t - h), p2 = value(t + 2 * h), m2 = value(t - 2 * h), v = value(t);
+				const auto first = (m2 - p2 + 8.0 * (p1 - m1)) / (12 * h);
+				const auto second = (16.0 * (p1 + m1) - p2 - m2 - 30.0 * v) / (12 * h * h);
+
+				const auto j = f.nativ_jet(t);
+				value_error = std::max(value_error, std::abs(j.value - v));
+				first_error = std::max(first_error, std::abs(j.first - first));
+				second_error = std::max(second_error, std::abs(j.second - second));
+				first_scale = std::max(first_scale, std::abs(first));
+				second_scale = std::max(second_scale, std::abs(second));
+				batch_error = std::max(batch_error, std::abs(batch[i].value - j.value) + std::abs(batch[i].first - j.first) + std::abs(batch[i].second - j.second));
+
+				const auto kappa = (std::conj(first) * second).imag() / std::pow(std::abs(first), 3);
+				curvature_error = std::max(curvature_error, std::abs(f.curvature(f.angleToIndex(t)) - kappa) / std::max(1e-3, std::abs(kappa)));
+			}
+			check_close(value_error, 1e-9, "nativ_jet value matches the direct sum" + name);
+			check_close(first_error, 1e-7 * first_scale, "nativ_jet first derivative matches finite differences" + name);
+			check_close(second_error, 1e-7 * second_scale, "nativ_jet second derivative matches finite differences" + name);
+			check_close(curvature_error, 1e-5, "curvature matches finite differences" + name);
+			check_close(batch_error, 1e-9 * second_scale, "nativ_jets matches nativ_jet" + name);
+		}
+	}
+
+	// RMS distance between the samples and the series at the sample angles
+	double brute_residual(const fourier& f, const std::vector<complex_double>& pts)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < pts.size(); ++i)
+			sum += std::norm(f.value(static_cast<double>(i)) - pts[i]);
+		return std::sqrt(sum / static_cast<double>(pts.size()));
+	}
+
+	void band_limited_fit()
+	{
+		for (const auto n : { size_t(64), size_t(101), size_t(256) })
+		{
+			const auto pts = contour(n);
+			const fourier full(pts.cbegin(), pts.cend());
+			const auto name = " n=" + std::to_string(n);
+
+			const fourier limited(pts.cbegin(), pts.cend(), 12);
+			check(limited.coeffs().size() == 12 && limited.is_truncated(), "band-limited fit keeps 12 harmonics" + name);
+			double error = std::abs(full.firstCoeff() - limited.firstCoeff());
+			for (size_t k = 0; k < limited.coeffs().size(); ++k)
+			{
+				error = std::max(error, std::abs(full.coeffs()[k].first - limited.coeffs()[k].first));
+				error = std::max(error, std::abs(full.coeffs()[k].second - limited.coeffs()[k].second));
+			}
+			check_close(error, 1e-9, "band-limited fit is the leading part of the full fit" + name);
+			check_close(std::abs(limited.residual() - brute_residual(limited, pts)), 1e-9, "residual matches the sample distances" + name);
+
+			// the tolerance picks the fewest harmonics that meet it
+			for (const auto tolerance : { 0.5, 1.0, 5.0, 50.0 })
+			{
+				const fourier fit(pts.cbegin(), pts.cend(), fourier::all_harmonics, tolerance);
+				const auto m = fit.coeffs().size();
+				const auto tolerated = name + " tolerance=" + std::to_string(tolerance);
+				check(brute_residual(fit, pts) <= tolerance + 1e-9, "tolerance fit stays within tolerance" + tolerated);
+				if (m > 0)
+				{
+					const fourier fewer(pts.cbegin(), pts.cend(), m - 1);
+					check(brute_residual(fewer, pts) > tolerance, "tolerance fit keeps no harmonic it could drop" + tolerated);
+				}
+			}
+
+			// moves stay rank-one under the limit
+			std::mt19937 rng(9);
+			std::uniform_real_distribution<double> coord(-300.0, 300.0);
+			auto moved = pts;
+			fourier f(moved.cbegin(), moved.cend(), 6);
+			for (int step = 0; step < 50; ++step)
+			{
+				const auto index = rng() % n;
+				const complex_double value(coord(rng), coord(rng));
+				f.update_point(index, moved[index], value);
+				moved[index] = value;
+			}
+			check_close(coeff_error(f, fourier(moved.cbegin(), moved.cend(), 6)), 1e-9, "band-limited update_point matches a refit" + name);
+			check_close(std::abs(f.residual() - brute_residual(f, moved)), 1e-9, "band-limited update_point keeps residual()" + name);
+		}
+
+		// a zero tolerance drops nothing, not even harmonics without energy
+		const std::vector<complex_double> flat(16, complex_double(3.0, -1.0));
+		const fourier still(flat.cbegin(), flat.cend(), fourier::all_harmonics, 0.0);
+		check(still.coeffs().size() == 8 && !still.is_truncated(), "zero tolerance keeps zero-energy harmonics");
+	}
+
+	void level_of_detail()
+	{
+		const auto pts = contour(512);
+		const fourier f(pts.cbegin(), pts.cend());
+		const auto angles = test_angles(2000);
+		std::vector<complex_double> full(angles.size());
+		f.nativ_values(angles.data(), angles.size(), full.data());
+
+		// the largest distance to the full curve, which the view's bound must cover
+		const auto distance = [&](const fourier::sub_series& view)
+		{
+			std::vector<complex_double> values(angles.size());
+			view.nativ_values(angles.data(), angles.size(), values.data());
+			double error = 0.0;
+			for (size_t i = 0; i < angles.size(); ++i)
+			{
+				error = std::max(error, std::abs(values[i] - full[i]));
+				error = std::max(error, std::abs(view.nativ_value(angles[i]) - full[i]));
+			}
+			return error;
+		};
+
+		for (const auto tolerance : { 0.0, 0.5, 2.0, 20.0, 1000.0 })
+		{
+			const auto view = f.lod(tolerance);
+			const auto name = " tolerance=" + std::to_string(tolerance);
+			check(view.error_bound() <= tolerance, "lod bound within tolerance" + name, view.error_bound());
+			check(view.terms() == f.lodForTolerance(tolerance), "lod keeps lodForTolerance harmonics" + name);
+			if (view.terms() > 0)
+				check(f.prefix(view.terms() - 1).error_bound() > tolerance, "lod keeps no harmonic it could drop" + name);
+			check_close(distance(view), view.error_bound() + 1e-9, "lod stays within its error bound" + name);
+		}
+
+		for (const size_t terms : { size_t(0), size_t(3), size_t(20), size_t(300) })
+		{
+			const auto prefix = f.prefix(terms);
+			const auto ranked = f.ranked(terms);
+			const auto name = " terms=" + std::to_string(terms);
+			check(ranked.error_bound() <= prefix.error_bound() + 1e-12, "ranked bound is no worse than prefix" + name);
+			check_close(distance(prefix), prefix.error_bound() + 1e-9, "prefix stays within its error bound" + name);
+			check_close(distance(ranked), ranked.error_bound() + 1e-9, "ranked stays within its error bound" + name);
+		}
+	}
+
+	void sliding_window()
+	{
+		const auto stream = contour(50000, 13);
+		for (const auto w : { size_t(100), size_t(127) })
+		{
+			for (const auto harmonics : { fourier::all_harmonics, size_t(8) })
+			{
+				const auto name = " w=" + std::to_string(w) + (harmonics == fourier::all_harmonics ? "" : " m=8");
+				const auto expected = [&](size_t pushed)
+				{
+					const auto last = stream.cbegin() + static_cast<std::ptrdiff_t>(w + pushed);
+					return fourier(last - static_cast<std::ptrdiff_t>(w), last, harmonics);
+				};
+
+				// resync only after far more pushes than the stream has: the error is pure drift
+				sliding_fourier drifting(stream.cbegin(), stream.cbegin() + static_cast<std::ptrdiff_t>(w), harmonics, stream.size());
+				sliding_fourier synced(stream.cbegin(), stream.cbegin() + static_cast<std::ptrdiff_t>(w), harmonics, 1000);
+				double drift = 0.0, synced_error = 0.0;
+				for (size_t pushed = 0; w + pushed < stream.size(); ++pushed)
+				{
+					if (pushed % 4999 == 0 || w + pushed + 1 == stream.size())
+					{
+						const auto reference = expected(pushed);
+						drift = std::max(drift, coeff_error(drifting.series(), reference));
+						synced_error = std::max(synced_error, coeff_error(synced.series(), reference));
+					}
+					drifting.push(stream[w + pushed]);
+					synced.push(stream[w + pushed]);
+				}
+				check_close(drift, 1e-10, "sliding window drift stays bounded" + name);
+				check_close(synced_error, 1e-11, "resynced sliding window matches a refit" + name);
+
+				drifting.resync();
+				check_close(coeff_error(drifting.series(), expected(stream.size() - w)), 1e-11, "resync() restores the window's fit" + name);
+			}
+		}
+	}
+
+	void batch()
+	{
+		const size_t n = 128;
+		std::vector<std::vector<complex_double>> curves;
+		for (unsigned i = 0; i < 40; ++i)
+			curves.push_back(contour(n, i + 1));
+
+		fourier_batch b(n, 32);
+		b.assign(curves.cbegin(), curves.cend());
+		b.push_back(curves[3].cbegin(), curves[3].cend());
+		check(b.size() == curves.size() + 1 && b.harmonics() == 32, "fourier_batch shape");
+
+		const auto angles = test_angles(37);
+		const auto values = b.values(angles);
+		const auto squares = b.squares();
+		const auto lengths = b.lengths(0.0, 1e-10);
+		const auto coarse_lengths = b.lengths();
+		double value_error = 0.0, square_error = 0.0, length_error = 0.0, coarse_error = 0.0;
+		for (size_t c = 0; c < b.size(); ++c)
+		{
+			const auto& pts = curves[c < curves.size() ? c : 3];
+			const fourier f(pts.cbegin(), pts.cend(), 32);
+			for (size_t j = 0; j < angles.size(); ++j)
+			{
+				const auto expected = direct_value(f.firstCoeff(), f.coeffs(), angles[j]);
+				value_error = std::max(value_error, std::abs(b.nativ_value(c, angles[j]) - expected));
+				value_error = std::max(value_error, std::abs(values[c * angles.size() + j] - expected));
+			}
+			square_error = std::max(square_error, std::abs(squares[c] - f.square()) / f.square());
+			const auto length = brute_length(f, 0.0, static_cast<double>(n), size_t(1) << 16);
+			length_error = std::max(length_error, std::abs(lengths[c] - length) / length);
+			coarse_error = std::max(coarse_error, std::abs(coarse_lengths[c] - length));
+		}
+		check_close(value_error, 1e-9, "fourier_batch values match the single-curve fit");
+		check_close(square_error, 1e-12, "fourier_batch squares match the single-curve fit");
+		check_close(length_error, 1e-6, "fourier_batch lengths match the polyline");
+		check_close(coarse_error, 0.1, "fourier_batch lengths within the default eps");
+	}
+
+	void coefficient_files()
+	{
+		const auto path = (std::filesystem::temp_directory_path() / "fourier_tests_coeffs.bin").string();
+
+		std::vector<std::unique_ptr<fourier>> series;
+		for (const auto n : { size_t(1), size_t(7), size_t(128), size_t(1000) })
+		{
+			const auto pts = contour(n, static_cast<unsigned>(n));
+			series.push_back(std::make_unique<fourier>(pts.cbegin(), pts.cend()));
+		}
+		const auto pts = contour(300);
+		series.push_back(std::make_unique<fourier>(pts.cbegin(), pts.cend(), 10));
+
+		const auto angles = test_angles(50);
+		for (const bool single : { false, true })
+		for (const bool streamed : { false, true })
+		{
+			const auto name = std::string(single ? " float32" : " float64") + (streamed ? " streamed" : "");
+			// float32 rows round the coefficients to about 1e-7 of the curve size
+			const auto tolerance = single ? 1e-3 : 1e-12;
+
+			if (streamed)
+			{
+				// coeff_stream_writer puts the directory after the blocks and patches the header on close
+				coeff_stream_writer writer(path, single);
+				for (const auto& f : series)
+					writer.add(*f);
+				check(writer.size() == series.size() && writer.close(), "coeff_stream_writer saves" + name);
+			}
+			else
+			{
+				coeff_writer writer(single);
+				for (const auto& f : series)
+					writer.add(*f);
+				check(writer.save(path), "coeff_writer saves" + name);
+			}
+
+			const coeff_file file(path);
+			check(file.is_open() && file.size() == series.size() && file.single_precision() == single, "coefficient file opens" + name);
+			if (!file.is_open() || file.size() != series.size())
+				continue;
+
+			double view_error = 0.0, load_error = 0.0;
+			for (size_t i = 0; i < series.size(); ++i)
+			{
+				const auto& f = *series[i];
+				const auto& view = file.curve(i);
+				check(view.samples() == f.samples().size() && view.harmonics() == f.coeffs().size(), "coefficient file curve shape" + name);
+				fourier loaded(pts.cbegin(), pts.cend());
+				file.load(i, loaded);
+				for (const auto angle : angles)
+				{
+					const auto expected = f.nativ_value(angle);
+					view_error = std::max(view_error, std::abs(view.nativ_value(angle) - expected));
+					load_error = std::max(load_error, std::abs(loaded.nativ_value(angle) - expected));
+				}
+
+				// a step that does not divide the span evenly still gives the series' sample count
+				std::vector<complex_double> view_values, series_values;
+				const auto end = static_cast<double>(f.samples().size());
+				view.values<complex_double>(std::back_inserter(view_values), 0.3, end, 0.013);
+				f.values<complex_double>(std::back_inserter(series_values), 0.3, end, 0.013);
+				check(view_values.size() == series_values.size(), "curve_view values() count" + name);
+				for (size_t j = 0; j < std::min(view_values.size(), series_values.size()); ++j)
+					view_error = std::max(view_error, std::abs(view_values[j] - series_values[j]));
+			}
+			check_close(view_error, tolerance, "curve_view values match the written series" + name);
+			check_close(load_error, tolerance, "loaded series match the written series" + name);
+		}
+
+		// a file cut short is refused rather than read past its end
+		const auto size = std::filesystem::file_size(path);
+		std::filesystem::resize_file(path, size - 1);
+		check(!coeff_file(path).is_open(), "truncated coefficient file is refused");
+		std::filesystem::remove(path);
+	}
+
+	// the same fit in another scalar type, checked against the double fit within that type's precision
+	template<class T> void scalar_type(const char* type, double tolerance)
+	{
+		const auto name = std::string(" ") + type;
+		for (const auto n : { size_t(17), size_t(128), size_t(601) })
+		{
+			const auto pts = contour(n);
+			const fourier reference(pts.cbegin(), pts.cend());
+			basic_fourier<T> f(pts.cbegin(), pts.cend());
+			const auto sized = name + " n=" + std::to_string(n);
+			const auto scale = std::abs(reference.firstCoeff()) + 250.0;
+
+			const auto angles = test_angles(200);
+			std::vector<T> local_angles(angles.cbegin(), angles.cend());
+			std::vector<std::complex<T>> batch(angles.size());
+			f.nativ_values(local_angles.data(), local_angles.size(), batch.data());
+			double error = 0.0;
+			for (size_t i = 0; i < angles.size(); ++i)
+			{
+				const auto expected = reference.nativ_value(angles[i]);
+				error = std::max(error, std::abs(complex_double(f.nativ_value(local_angles[i])) - expected));
+				error = std::max(error, std::abs(complex_double(batch[i]) - expected));
+			}
+			check_close(error, tolerance * scale, "values match the double fit" + sized);
+
+			// a step of 0.01 drifts within a few thousand additions in float
+			std::vector<std::complex<T>> values;
+			f.template values<std::complex<T>>(std::back_inserter(values), T(0), static_cast<T>(n), T(0.01));
+			check(values.size() == 100 * n, "values() count" + sized);
+
+			const auto length = brute_length(reference, 0.0, static_cast<double>(n), size_t(1) << 16);
+			check_close(std::abs(static_cast<double>(f.length(T(0), static_cast<T>(n))) - length), 10 * tolerance * length + 0.1, "length matches the double fit" + sized);
+			check_close(std::abs(static_cast<double>(f.square()) - reference.square()), tolerance * reference.square(), "square matches the double fit" + sized);
+
+			const complex_double moved(12.5, -3.0);
+			f.update_point(n / 2, std::complex<T>(pts[n / 2]), std::complex<T>(moved));
+			auto edited = pts;
+			edited[n / 2] = moved;
+			const fourier refit(edited.cbegin(), edited.cend());
+			check_close(std::abs(complex_double(f.nativ_value(T(1))) - refit.nativ_value(1.0)), tolerance * scale, "update_point matches the double refit" + sized);
+		}
+	}
+
+	void scalar_types()
+	{
+		scalar_type<float>("float", 1e-5);
+		scalar_type<long double>("long double", 1e-12);
+	}
+
+	template<size_t M> void fixed_series(size_t n)
+	{
+		const auto pts = contour(n);
+		const fourier f(pts.cbegin(), pts.cend(), M);
+		const fixed_fourier<M> fixed(pts.cbegin(), pts.cend());
+		const auto name = " M=" + std::to_string(M) + " n=" + std::to_string(n);
+		const auto angles = test_angles(100);
+
+		std::vector<complex_double> batch(angles.size());
+		fixed.nativ_values(angles.data(), angles.size(), batch.data());
+		double error = 0.0, derivative_error = 0.0;
+		for (size_t i = 0; i < angles.size(); ++i)
+		{
+			const auto expected = direct_value(f.firstCoeff(), f.coeffs(), angles[i]);
+			error = std::max(error, std::abs(fixed.nativ_value(angles[i]) - expected));
+			error = std::max(error, std::abs(batch[i] - expected));
+			derivative_error = std::max(derivative_error, std::abs(fixed.nativ_derivative_value(std::polar(1.0, angles[i])) - direct_derivative(f.coeffs(), angles[i])));
+		}
+		check_close(error, 1e-9, "fixed_fourier matches the direct sum" + name);
+		check_close(derivative_error, 1e-8, "fixed_fourier derivative matches the direct sum" + name);
+
+		std::vector<complex_double> values, expected;
+		fixed.template values<complex_double>(std::back_inserter(values), 0.5, static_cast<double>(n), 0.3);
+		f.values<complex_double>(std::back_inserter(expected), 0.5, static_cast<double>(n), 0.3);
+		error = values.size() == expected.size() ? 0.0 : HUGE_VAL;
+		for (size_t i = 0; i < values.size() && i < expected.size(); ++i)
+			error = std::max(error, std::abs(values[i] - expected[i]));
+		check_close(error, 1e-9, "fixed_fourier values() match fourier" + name);
+	}
+
+	void fixed()
+	{
+		fixed_series<16>(256);
+		// fewer harmonics than M: the missing ones are zero
+		fixed_series<16>(11);
+		// past the re-anchoring period
+		fixed_series<100>(300);
+	}
+
+	double segment_distance(const complex_double& p, const complex_double& a, const complex_double& b)
+	{
+		const auto d = b - a;
+		const auto len2 = std::norm(d);
+		const auto u = len2 > 0.0 ? std::clamp(((p - a) * std::conj(d)).real() / len2, 0.0, 1.0) : 0.0;
+		return std::abs(p - (a + u * d));
+	}
+
+	void tessellation()
+	{
+		for (const auto n : { size_t(7), size_t(100), size_t(257) })
+		{
+			const auto pts = contour(n);
+			const fourier f(pts.cbegin(), pts.cend());
+			const auto full = static_cast<double>(n);
+			const auto dense = f.resample(size_t(1) << 16);
+
+			for (const auto tolerance : { 0.05, 0.5, 2.0 })
+			{
+				const auto name = " n=" + std::to_string(n) + " tolerance=" + std::to_string(tolerance);
+				std::vector<complex_double> polyline;
+				f.tessellate<complex_double>(std::back_inserter(polyline), 0.0, full, tolerance);
+				check(polyline.size() >= 2
+					&& std::abs(polyline.front() - f.value(0.0)) < 1e-9
+					&& std::abs(polyline.back() - f.value(full)) < 1e-9, "tessellate spans the whole range" + name);
+				if (polyline.size() < 2)
+					continue;
+
+				// both walk the curve in the same direction, so the nearest chord only moves forward
+				double error = 0.0;
+				size_t segment = 0;
+				for (const auto& p : dense)
+				{
+					while (segment + 2 < polyline.size()
+						&& segment_distance(p, polyline[segment + 1], polyline[segment + 2]) <= segment_distance(p, polyline[segment], polyline[segment + 1]))
+						++segment;
+					error = std::max(error, segment_distance(p, polyline[segment], polyline[segment + 1]));
+				}
+				check_close(error, tolerance, "tessellation stays within tolerance" + name);
+			}
+		}
+	}
+}
+
+int main()
+{
+	fft_fit();
+	point_edits();
+	evaluation();
+	dense_values();
+	long_series();
+	pool();
+	arc_length();
+	arc_table();
+	closest_point();
+	jets();
+	band_limited_fit();
+	level_of_detail();
+	sliding_window();
+	batch();
+	coefficient_files();
+	scalar_types();
+	fixed();
+	tessellation();
+
+	if (failures == 0)
+		std::printf("all checks passed\n");
+	return failures;
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <type_traits>
+#include <algorithm>
+
+namespace fourtd
+{
+	// Persistent work-stealing pool: every worker owns a deque, pops its own newest task
+	// and steals the oldest task of the others when it runs dry.
+	class thread_pool
+	{
+		using task = std::function<void()>;
+
+		struct task_queue
+		{
+			std::mutex mutex;
+			std::deque<task> tasks;
+		};
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator =(const thread_pool&) = delete;
+
+	public:
+		explicit thread_pool(size_t worker_count = std::thread::hardware_concurrency()) :
+			queues(std::max<size_t>(1, worker_count))
+		{
+			workers.reserve(queues.size());
+			for (size_t i = 0; i < queues.size(); ++i)
+				workers.emplace_back([this, i] { run(i); });
+		}
+
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				stopped = true;
+			}
+			wake.notify_all();
+			for (auto& worker : workers)
+				worker.join();
+		}
+
+		size_t size() const noexcept
+		{
+			return workers.size();
+		}
+
+		// process-wide pool, one worker per hardware thread
+		static thread_pool& shared()
+		{
+			static thread_pool pool;
+			return pool;
+		}
+
+		template<class F> auto submit(F&& f)
+		{
+			using result_type = std::invoke_result_t<std::decay_t<F>>;
+			auto job = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(f));
+			auto result = job->get_future();
+			push([job] { (*job)(); });
+			return result;
+		}
+
+		// Calls fun(first, last) on consecutive chunks of [begin, end). The calling thread works
+		// through chunks as well, so nested calls from inside a task cannot starve the pool.
+		template<class Fun> void parallel_for(size_t begin, size_t end, Fun&& fun, size_t grain = 1)
+		{
+			if (begin >= end) return;
+
+			grain = std::max<size_t>(1, grain);
+			const size_t chunks = std::min((end - begin + grain - 1) / grain, 4 * (size() + 1));
+			if (chunks == 1)
+			{
+				fun(begin, end);
+				return;
+			}
+
+			struct state
+			{
+				std::atomic<size_t> next{ 0 };
+				std::atomic<size_t> done{ 0 };
+				std::mutex mutex;
+				std::condition_variable finished;
+				std::exception_ptr error;
+			};
+			auto shared_state = std::make_shared<state>();
+
+			const auto work = [shared_state, &fun, begin, end, chunks]
+			{
+				auto& s = *shared_state;
+				for (size_t i; (i = s.next.fetch_add(1)) < chunks;)
+				{
+					try
+					{
+						fun(begin + (end - begin) * i / chunks, begin + (end - begin) * (i + 1) / chunks);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(s.mutex);
+						if (!s.error)
+							s.error = std::current_exception();
+					}
+
+					if (s.done.fetch_add(1) + 1 == chunks)
+					{
+						std::lock_guard<std::mutex> lock(s.mutex);
+						s.finished.notify_all();
+					}
+				}
+			};
+
+			for (size_t i = 0, helpers = std::min(size(), chunks - 1); i < helpers; ++i)
+				push(work);
+			work();
+
+			std::unique_lock<std::mutex> lock(shared_state->mutex);
+			shared_state->finished.wait(lock, [&shared_state, chunks] { return shared_state->done == chunks; });
+			if (shared_state->error)
+				std::rethrow_exception(shared_state->error);
+		}
+
+	private:
+		// index of the calling worker's queue, or npos outside this pool
+		size_t current_worker() const noexcept
+		{
+			return owner == this ? owner_index : npos;
+		}
+
+		void push(task&& t)
+		{
+			auto index = current_worker();
+			if (index == npos)
+				index = next_queue.fetch_add(1) % queues.size();
+
+			{
+				std::lock_guard<std::mutex> lock(queues[index].mutex);
+				queues[index].tasks.push_back(std::move(t));
+			}
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				++pending;
+			}
+			wake.notify_one();
+		}
+
+		bool try_pop(size_t index, task& t)
+		{
+			{
+				auto& own = queues[index];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (!own.tasks.empty())
+				{
+					t = std::move(own.tasks.back());
+					own.tasks.pop_back();
+					return true;
+				}
+			}
+
+			for (size_t i = 1; i < queues.size(); ++i)
+			{
+				auto& victim = queues[(index + i) % queues.size()];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.tasks.empty())
+				{
+					t = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void run(size_t index)
+		{
+			owner = this;
+			owner_index = index;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(sleep_mutex);
+					wake.wait(lock, [this] { return stopped || pending != 0; });
+					if (pending == 0)
+						return;
+					--pending;
+				}
+
+				task t;
+				while (!try_pop(index, t))
+					std::this_thread::yield();
+				t();
+			}
+		}
+
+		static constexpr size_t npos = static_cast<size_t>(-1);
+		inline static thread_local const thread_pool* owner = nullptr;
+		inline static thread_local size_t owner_index = npos;
+
+		std::vector<task_queue> queues;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> next_queue{ 0 };
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		size_t pending = 0;
+		bool stopped = false;
+	};
+}
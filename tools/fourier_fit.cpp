@@ -0,0 +1,489 @@
+// Headless batch fitting: reads point curves, fits each one and writes its area and length.
+// Parsing, fitting and writing run as a pipeline over bounded queues, so memory stays flat on
+// inputs of any size and the fit stage keeps every core busy.
+//
+//   fourier_fit [--input=csv|binary] [--out=<file>] [--coeffs=<file>] [--single]
+//               [--harmonics=<m>] [--tolerance=<rms>] [--rel_eps=<length tolerance>]
+//               [--threads=<n>] [<points file>]
+//
+// csv: one "x,y" point per line (',', ';', tab or space separated), a blank line ends a curve,
+// lines starting with '#' are skipped. A file without blank lines is one curve; empty curves are skipped.
+// binary: records of a little-endian uint64 point count followed by that many (x, y) doubles in
+// the byte order of the host.
+// Without a points file the input is read from stdin.
+//
+// The output is a csv row per curve, in input order: curve,samples,harmonics,square,length.
+// --coeffs also writes the fitted series as a coefficient file (coeff_file.hpp), streamed block by
+// block in input order; only its directory is kept until the end.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "trinterp.hpp"
+#include "coeff_file.hpp"
+
+using namespace fourtd;
+
+namespace
+{
+	struct options
+	{
+		std::string input = "csv";
+		std::string in;
+		std::string out;
+		std::string coeffs;
+		bool single = false;
+		size_t harmonics = fourier::all_harmonics;
+		double tolerance = 0.0;
+		double rel_eps = 1e-6;
+		size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	};
+
+	// curves handed from one stage to the next together, to keep queue traffic low for small curves
+	constexpr size_t chunk_curves = 256;
+	constexpr size_t chunk_points = size_t(1) << 16;
+
+	struct chunk
+	{
+		size_t sequence;
+		size_t first_curve;
+		std::vector<std::vector<complex_double>> curves;
+	};
+
+	struct measured
+	{
+		size_t samples;
+		size_t harmonics;
+		double square;
+		double length;
+		// the series itself, only with --coeffs
+		complex_double a0;
+		std::vector<std::pair<complex_double, complex_double>> ab;
+	};
+
+	struct result
+	{
+		size_t sequence;
+		size_t first_curve;
+		std::vector<measured> curves;
+	};
+
+	// Blocking FIFO of at most capacity items. close() wakes every waiter: push then drops the
+	// item and returns false, pop drains what is left and then returns nothing.
+	template<class T> class bounded_queue
+	{
+	public:
+		explicit bounded_queue(size_t capacity) :
+			capacity(std::max<size_t>(1, capacity))
+		{
+		}
+
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+			if (closed)
+				return false;
+			items.push_back(std::move(item));
+			not_empty.notify_one();
+			return true;
+		}
+
+		std::optional<T> pop()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_empty.wait(lock, [this] { return closed || !items.empty(); });
+			if (items.empty())
+				return std::nullopt;
+			T item = std::move(items.front());
+			items.pop_front();
+			not_full.notify_one();
+			return item;
+		}
+
+		void close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				closed = true;
+			}
+			not_full.notify_all();
+			not_empty.notify_all();
+		}
+
+	private:
+		const size_t capacity;
+		std::mutex mutex;
+		std::condition_variable not_full;
+		std::condition_variable not_empty;
+		std::deque<T> items;
+		bool closed = false;
+	};
+
+	// Cuts the parsed curves into chunks and pushes them downstream; false once the queue is closed.
+	class chunker
+	{
+	public:
+		explicit chunker(bounded_queue<chunk>& queue) :
+			queue(queue)
+		{
+		}
+
+		std::vector<complex_double>& curve()
+		{
+			return current;
+		}
+
+		bool end_curve()
+		{
+			if (current.empty())
+				return true;
+			points += current.size();
+			pending.curves.push_back(std::move(current));
+			current.clear();
+			return pending.curves.size() < chunk_curves && points < chunk_points ? true : flush();
+		}
+
+		bool finish()
+		{
+			return end_curve() && flush();
+		}
+
+	private:
+		bool flush()
+		{
+			if (pending.curves.empty())
+				return true;
+			const auto count = pending.curves.size();
+			pending.sequence = sequence++;
+			const bool open = queue.push(std::move(pending));
+			pending = chunk{ 0, next_curve += count, {} };
+			points = 0;
+			return open;
+		}
+
+		bounded_queue<chunk>& queue;
+		std::vector<complex_double> current;
+		chunk pending{ 0, 0, {} };
+		size_t sequence = 0;
+		size_t next_curve = 0;
+		size_t points = 0;
+	};
+
+	void parse_csv(std::istream& in, chunker& out)
+	{
+		std::string line;
+		size_t line_number = 0;
+		while (std::getline(in, line))
+		{
+			++line_number;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			const auto first = line.find_first_not_of(" \t");
+			if (first == std::string::npos)
+			{
+				if (!out.end_curve())
+					return;
+				continue;
+			}
+			if (line[first] == '#')
+				continue;
+
+			const char* s = line.c_str() + first;
+			char* end = nullptr;
+			const double x = std::strtod(s, &end);
+			if (end == s)
+				throw std::runtime_error("line " + std::to_string(line_number) + ": expected x,y");
+			s = end + std::strspn(end, " \t,;");
+			const double y = std::strtod(s, &end);
+			if (end == s)
+				throw std::runtime_error("line " + std::to_string(line_number) + ": expected x,y");
+			out.curve().emplace_back(x, y);
+		}
+		out.finish();
+	}
+
+	void parse_binary(std::istream& in, chunker& out)
+	{
+		unsigned char header[8];
+		std::vector<double> xy;
+		while (in.read(reinterpret_cast<char*>(header), sizeof(header)))
+		{
+			uint64_t count = 0;
+			for (size_t i = sizeof(header); i-- > 0; )
+				count = count << 8 | header[i];
+			if (count > std::numeric_limits<size_t>::max() / (2 * sizeof(double)))
+				throw std::runtime_error("record of " + std::to_string(count) + " points");
+
+			xy.resize(2 * static_cast<size_t>(count));
+			if (!in.read(reinterpret_cast<char*>(xy.data()), static_cast<std::streamsize>(xy.size() * sizeof(double))))
+				throw std::runtime_error("truncated record");
+			auto& curve = out.curve();
+			curve.reserve(xy.size() / 2);
+			for (size_t i = 0; i < xy.size(); i += 2)
+				curve.emplace_back(xy[i], xy[i + 1]);
+			if (!out.end_curve())
+				return;
+		}
+		if (in.gcount() != 0)
+			throw std::runtime_error("truncated record header");
+		out.finish();
+	}
+
+	// One per fitting thread. The series is refitted for every curve, so its buffers and FFT plan
+	// are reused while consecutive curves have the same length. Its own parallel loops run on
+	// workers, which only has the cores the fitting threads leave free.
+	class fitter
+	{
+	public:
+		fitter(const options& opt, thread_pool& workers) :
+			opt(opt),
+			workers(workers)
+		{
+		}
+
+		measured operator()(const std::vector<complex_double>& pts)
+		{
+			const bool band_limited = opt.harmonics != fourier::all_harmonics || opt.tolerance != 0.0;
+			if (!f)
+			{
+				f = std::make_unique<fourier>(pts.cbegin(), pts.cbegin());
+				f->set_workers(workers);
+			}
+			if (band_limited)
+				f->calcul_coeff(pts.cbegin(), pts.cend(), opt.harmonics, opt.tolerance);
+			else
+				f->calcul_coeff(pts.cbegin(), pts.cend());
+
+			const auto n = pts.size();
+			measured m{ n, f->coeffs().size(), f->square(), f->length(0, static_cast<double>(n), 0.0, opt.rel_eps), {}, {} };
+			if (!opt.coeffs.empty())
+			{
+				m.a0 = f->firstCoeff();
+				m.ab = f->coeffs();
+			}
+			return m;
+		}
+
+	private:
+		const options& opt;
+		thread_pool& workers;
+		std::unique_ptr<fourier> f;
+	};
+
+	bool parse(int argc, char* argv[], options& opt)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const auto eq = arg.find('=');
+			const auto key = arg.substr(0, eq);
+			const auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+			if (key == "--input" && (value == "csv" || value == "binary"))
+				opt.input = value;
+			else if (key == "--out")
+				opt.out = value;
+			else if (key == "--coeffs")
+				opt.coeffs = value;
+			else if (key == "--single" && eq == std::string::npos)
+				opt.single = true;
+			else if (key == "--harmonics")
+				opt.harmonics = std::stoul(value);
+			else if (key == "--tolerance")
+				opt.tolerance = std::stod(value);
+			else if (key == "--rel_eps")
+				opt.rel_eps = std::stod(value);
+			else if (key == "--threads" && std::stoul(value) > 0)
+				opt.threads = std::stoul(value);
+			else if ((arg.size() > 1 && arg[0] == '-') || !opt.in.empty())
+			{
+				std::cerr << "usage: fourier_fit [--input=csv|binary] [--out=<file>] [--coeffs=<file>] [--single] [--harmonics=<m>] [--tolerance=<rms>] [--rel_eps=<length tolerance>] [--threads=<n>] [<points file>]\n";
+				return false;
+			}
+			else
+				opt.in = arg;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	try
+	{
+		if (!parse(argc, argv, opt))
+			return 1;
+	}
+	catch (const std::exception&)
+	{
+		std::cerr << "fourier_fit: bad option value\n";
+		return 1;
+	}
+
+	std::ifstream file;
+	if (!opt.in.empty() && opt.in != "-")
+	{
+		file.open(opt.in, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "fourier_fit: cannot open " << opt.in << '\n';
+			return 1;
+		}
+	}
+	std::istream& in = file.is_open() ? file : std::cin;
+
+	std::ofstream out_file;
+	if (!opt.out.empty())
+	{
+		out_file.open(opt.out);
+		if (!out_file)
+		{
+			std::cerr << "fourier_fit: cannot write " << opt.out << '\n';
+			return 1;
+		}
+	}
+	std::ostream& out = out_file.is_open() ? out_file : std::cout;
+
+	std::optional<coeff_stream_writer> coeffs;
+	if (!opt.coeffs.empty())
+	{
+		coeffs.emplace(opt.coeffs, opt.single);
+		if (!*coeffs)
+		{
+			std::cerr << "fourier_fit: cannot write " << opt.coeffs << '\n';
+			return 1;
+		}
+	}
+
+	// a few chunks in flight per fitting thread; the parser blocks once they are all taken
+	bounded_queue<chunk> parsed(2 * opt.threads);
+	bounded_queue<result> fitted(2 * opt.threads);
+
+	std::mutex error_mutex;
+	std::exception_ptr error;
+	const auto fail = [&](std::exception_ptr e)
+	{
+		{
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if (!error)
+				error = e;
+		}
+		parsed.close();
+		fitted.close();
+	};
+
+	std::thread parser([&]
+		{
+			try
+			{
+				chunker chunks(parsed);
+				if (opt.input == "binary")
+					parse_binary(in, chunks);
+				else
+					parse_csv(in, chunks);
+				parsed.close();
+			}
+			catch (...)
+			{
+				fail(std::current_exception());
+			}
+		}
+	);
+
+	// the fitting threads already use opt.threads cores; the default shared pool would add as many again
+	const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+	thread_pool series_workers(cores > opt.threads ? cores - opt.threads : 1);
+
+	std::vector<std::thread> fitters;
+	std::atomic<size_t> running{ opt.threads };
+	for (size_t i = 0; i < opt.threads; ++i)
+	{
+		fitters.emplace_back([&]
+			{
+				try
+				{
+					fitter measure(opt, series_workers);
+					while (auto c = parsed.pop())
+					{
+						result r{ c->sequence, c->first_curve, {} };
+						r.curves.reserve(c->curves.size());
+						for (const auto& pts : c->curves)
+							r.curves.push_back(measure(pts));
+						if (!fitted.push(std::move(r)))
+							break;
+					}
+				}
+				catch (...)
+				{
+					fail(std::current_exception());
+				}
+				if (--running == 0)
+					fitted.close();
+			}
+		);
+	}
+
+	// the writer restores the input order of the chunks
+	std::map<size_t, result> early;
+	size_t next = 0;
+	out.precision(std::numeric_limits<double>::max_digits10);
+	out << "curve,samples,harmonics,square,length\n";
+	while (auto r = fitted.pop())
+	{
+		early.emplace(r->sequence, std::move(*r));
+		for (auto it = early.begin(); it != early.end() && it->first == next; it = early.erase(it), ++next)
+		{
+			const auto& ready = it->second;
+			for (size_t i = 0; i < ready.curves.size(); ++i)
+			{
+				const auto& m = ready.curves[i];
+				out << ready.first_curve + i << ',' << m.samples << ',' << m.harmonics << ',' << m.square << ',' << m.length << '\n';
+				if (coeffs)
+					coeffs->add(m.samples, m.a0, m.ab);
+			}
+		}
+	}
+
+	parser.join();
+	for (auto& t : fitters)
+		t.join();
+
+	if (error)
+	{
+		try
+		{
+			std::rethrow_exception(error);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "fourier_fit: " << e.what() << '\n';
+		}
+		return 1;
+	}
+	if (coeffs && !coeffs->close())
+	{
+		std::cerr << "fourier_fit: cannot write " << opt.coeffs << '\n';
+		return 1;
+	}
+	out.flush();
+	return out ? 0 : 1;
+}
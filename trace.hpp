@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+// Stage timing for the fit, evaluate and render paths. Build with FOURTD_TRACE=1 to record; otherwise
+// FOURTD_TRACE_SCOPE and FOURTD_TRACE_COUNTER expand to nothing and no buffer is ever touched.
+#ifndef FOURTD_TRACE
+#define FOURTD_TRACE 0
+#endif
+
+#define FOURTD_TRACE_CAT2(a, b) a##b
+#define FOURTD_TRACE_CAT(a, b) FOURTD_TRACE_CAT2(a, b)
+
+#if FOURTD_TRACE
+#define FOURTD_TRACE_SCOPE(name) const ::fourtd::trace::scope FOURTD_TRACE_CAT(fourtd_trace_scope_, __LINE__)(name)
+#define FOURTD_TRACE_COUNTER(name, value) ::fourtd::trace::counter(name, static_cast<std::int64_t>(value))
+#else
+#define FOURTD_TRACE_SCOPE(name) ((void)0)
+#define FOURTD_TRACE_COUNTER(name, value) ((void)0)
+#endif
+
+namespace fourtd
+{
+	namespace trace
+	{
+		inline constexpr bool enabled = FOURTD_TRACE != 0;
+
+		enum class kind : std::uint8_t
+		{
+			complete,
+			counter
+		};
+
+		// name is a string literal; times are nanoseconds since the first call of now()
+		struct event
+		{
+			const char* name;
+			kind type;
+			std::uint32_t thread;
+			std::uint64_t start;
+			std::uint64_t duration;
+			std::int64_t value;
+		};
+
+		inline std::uint64_t now() noexcept
+		{
+			using clock = std::chrono::steady_clock;
+			static const auto epoch = clock::now();
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count());
+		}
+
+		// small per-thread number for the trace viewer, in order of first use
+		inline std::uint32_t thread_index() noexcept
+		{
+			static std::atomic<std::uint32_t> next{ 0 };
+			thread_local const std::uint32_t index = next.fetch_add(1, std::memory_order_relaxed) + 1;
+			return index;
+		}
+
+		// Fixed ring of the newest capacity events. Writers claim a slot with one fetch_add and never
+		// wait; each slot is a seqlock, so a reader skips slots that are being overwritten instead of
+		// blocking the writer. A writer lapped by another one capacity events later can still mix
+		// two events, which only happens if the ring is far too small for the event rate.
+		class ring
+		{
+		public:
+			static constexpr size_t capacity = size_t(1) << 16;
+
+			void push(const event& e) noexcept
+			{
+				const auto pos = head.fetch_add(1, std::memory_order_relaxed);
+				auto& s = slots[pos & (capacity - 1)];
+				s.seq.store(0, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				s.name.store(e.name, std::memory_order_relaxed);
+				s.type.store(e.type, std::memory_order_relaxed);
+				s.thread.store(e.thread, std::memory_order_relaxed);
+				s.start.store(e.start, std::memory_order_relaxed);
+				s.duration.store(e.duration, std::memory_order_relaxed);
+				s.value.store(e.value, std::memory_order_relaxed);
+				s.seq.store(pos + 1, std::memory_order_release);
+			}
+
+			// up to max_events of the newest finished events, oldest first
+			std::vector<event> snapshot(size_t max_events = capacity) const
+			{
+				const auto end = head.load(std::memory_order_acquire);
+				const auto count = std::min<std::uint64_t>({ end, capacity, max_events });
+				std::vector<event> result;
+				result.reserve(count);
+				for (auto pos = end - count; pos < end; ++pos)
+				{
+					const auto& s = slots[pos & (capacity - 1)];
+					const auto seq = s.seq.load(std::memory_order_acquire);
+					if (seq != pos + 1)
+						continue;
+					const event e
+					{
+						s.name.load(std::memory_order_relaxed),
+						s.type.load(std::memory_order_relaxed),
+						s.thread.load(std::memory_order_relaxed),
+						s.start.load(std::memory_order_relaxed),
+						s.duration.load(std::memory_order_relaxed),
+						s.value.load(std::memory_order_relaxed)
+					};
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (s.seq.load(std::memory_order_relaxed) == seq)
+						result.push_back(e);
+				}
+				return result;
+			}
+
+		private:
+			struct slot
+			{
+				std::atomic<std::uint64_t> seq{ 0 };
+				std::atomic<const char*> name{ nullptr };
+				std::atomic<kind> type{ kind::complete };
+				std::atomic<std::uint32_t> thread{ 0 };
+				std::atomic<std::uint64_t> start{ 0 };
+				std::atomic<std::uint64_t> duration{ 0 };
+				std::atomic<std::int64_t> value{ 0 };
+			};
+
+			std::atomic<std::uint64_t> head{ 0 };
+			slot slots[capacity];
+		};
+
+		inline ring& events()
+		{
+			static ring instance;
+			return instance;
+		}
+
+		inline void counter(const char* name, std::int64_t value) noexcept
+		{
+			events().push({ name, kind::counter, thread_index(), now(), 0, value });
+		}
+
+		// records the time from construction to destruction as one complete event
+		class scope
+		{
+			scope(const scope&) = delete;
+			scope& operator =(const scope&) = delete;
+
+		public:
+			explicit scope(const char* name) noexcept :
+				name(name),
+				start(now())
+			{
+			}
+
+			~scope()
+			{
+				events().push({ name, kind::complete, thread_index(), start, now() - start, 0 });
+			}
+
+		private:
+			const char* name;
+			std::uint64_t start;
+		};
+
+		// per-name totals of the complete events that started at or after since
+		struct stage
+		{
+			const char* name;
+			size_t count;
+			std::uint64_t total;
+			std::uint64_t longest;
+		};
+
+		inline std::vector<stage> summarize(const std::vector<event>& trace, std::uint64_t since = 0)
+		{
+			std::vector<stage> result;
+			for (const auto& e : trace)
+			{
+				if (e.type != kind::complete || e.start < since)
+					continue;
+				auto it = std::find_if(result.begin(), result.end(), [&e](const stage& s) { return std::strcmp(s.name, e.name) == 0; });
+				if (it == result.end())
+					it = result.insert(result.end(), { e.name, 0, 0, 0 });
+				++it->count;
+				it->total += e.duration;
+				it->longest = std::max(it->longest, e.duration);
+			}
+			return result;
+		}
+
+		// Chrome trace event format, readable by chrome://tracing and Perfetto
+		inline void write_chrome_trace(std::ostream& out, const std::vector<event>& trace)
+		{
+			const auto flags = out.flags();
+			out.setf(std::ios::fixed);
+			out.precision(3);
+			out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			const char* separator = "\n";
+			for (const auto& e : trace)
+			{
+				out << separator << "{\"name\":\"" << e.name << "\",\"pid\":1,\"tid\":" << e.thread << ",\"ts\":" << e.start / 1e3;
+				if (e.type == kind::complete)
+					out << ",\"ph\":\"X\",\"dur\":" << e.duration / 1e3 << '}';
+				else
+					out << ",\"ph\":\"C\",\"args\":{\"" << e.name << "\":" << e.value << "}}";
+				separator = ",\n";
+			}
+			out << "\n]}\n";
+			out.flags(flags);
+		}
+	}
+}
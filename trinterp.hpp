@@ -1,67 +1,456 @@
 #pragma once
-#include <execution>
 #include <cmath>
 #include <vector>
 #include <complex>
 #include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <type_traits>
 #include <future>
+#include <memory>
+#include <mutex>
+#include "thread_pool.hpp"
+
+// batch kernels are compiled for several instruction sets and picked at load time. That dispatch
+// needs target_clones, so it exists only on GCC and Clang for x86; MSVC and other targets get a
+// single kernel built for the instruction set the whole project is compiled for (e.g. /arch:AVX2).
+#if defined(__has_attribute)
+#if __has_attribute(target_clones) && (defined(__x86_64__) || defined(__i386__))
+#define FOURTD_TARGET_CLONES __attribute__((target_clones("arch=skylake-avx512", "arch=haswell", "default")))
+#endif
+#endif
+#ifndef FOURTD_TARGET_CLONES
+#define FOURTD_TARGET_CLONES
+#endif
 
 namespace fourtd
 {
-	inline constexpr double pi = 3.1415926535897932385;
+	template<class T> inline constexpr T pi_v = static_cast<T>(3.14159265358979323846264338327950288L);
+	inline constexpr double pi = pi_v<double>;
 	using complex_double = std::complex<double>;
 
-	class fourier
+	// Conversion of a user point type to and from the complex plane. Specialize both for the
+	// point type; the one pair serves every scalar type of basic_fourier.
+	template<class C> complex_double make_complex(C&& c);
+	template<class C> C make_value(const complex_double& z);
+
+	// In-place discrete Fourier transform of a fixed length:
+	// radix-2 for powers of two, Bluestein's chirp-z for any other length.
+	template<class T> class basic_fft_plan
+	{
+	public:
+		using complex_type = std::complex<T>;
+
+		explicit basic_fft_plan(size_t n) :
+			n(n)
+		{
+			if (n < 2) return;
+			if (is_pow2(n))
+			{
+				// stage of length 2h keeps its h twiddles contiguous at offset h-1
+				twiddles.reserve(n - 1);
+				for (size_t half = 1; half < n; half *= 2)
+					for (size_t j = 0; j < half; ++j)
+						twiddles.push_back(std::polar(T(1), -pi_v<T> * static_cast<T>(j) / static_cast<T>(half)));
+				return;
+			}
+
+			size_t m = 1;
+			while (m < 2 * n - 1) m *= 2;
+			inner = std::make_unique<basic_fft_plan>(m);
+
+			// w_j = e^(-i*pi*j^2/n); j^2 is reduced mod 2n to keep the angle small
+			chirp.reserve(n);
+			for (size_t j = 0; j < n; ++j)
+				chirp.push_back(std::polar(T(1), -pi_v<T> * static_cast<T>((j * j) % (2 * n)) / static_cast<T>(n)));
+
+			chirp_spectrum.assign(m, complex_type{});
+			chirp_spectrum[0] = std::conj(chirp[0]);
+			for (size_t j = 1; j < n; ++j)
+				chirp_spectrum[j] = chirp_spectrum[m - j] = std::conj(chirp[j]);
+			inner->forward(chirp_spectrum.data());
+		}
+
+		size_t size() const noexcept
+		{
+			return n;
+		}
+
+		// X_k = sum_j x_j * e^(-2*pi*i*j*k/n), unnormalized
+		void forward(complex_type* data) const
+		{
+			if (n < 2) return;
+			if (inner)
+				bluestein(data);
+			else
+				radix2(data);
+		}
+
+		// x_j = sum_k X_k * e^(2*pi*i*j*k/n), unnormalized
+		void inverse(complex_type* data) const
+		{
+			std::transform(data, data + n, data, [](const complex_type& z) { return std::conj(z); });
+			forward(data);
+			std::transform(data, data + n, data, [](const complex_type& z) { return std::conj(z); });
+		}
+
+	private:
+		static bool is_pow2(size_t n) noexcept
+		{
+			return (n & (n - 1)) == 0;
+		}
+
+		void radix2(complex_type* data) const noexcept
+		{
+			for (size_t i = 1, j = 0; i < n; ++i)
+			{
+				size_t bit = n >> 1;
+				for (; j & bit; bit >>= 1)
+					j ^= bit;
+				j ^= bit;
+				if (i < j)
+					std::swap(data[i], data[j]);
+			}
+
+			for (size_t half = 1; half < n; half *= 2)
+			{
+				const auto* w = &twiddles[half - 1];
+				for (size_t i = 0; i < n; i += 2 * half)
+				{
+					for (size_t j = 0; j < half; ++j)
+					{
+						const auto t = mul(w[j], data[i + j + half]);
+						data[i + j + half] = data[i + j] - t;
+						data[i + j] += t;
+					}
+				}
+			}
+		}
+
+		// plain complex product, without the inf/nan recovery of operator*
+		static complex_type mul(const complex_type& a, const complex_type& b) noexcept
+		{
+			return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+		}
+
+		void bluestein(complex_type* data) const
+		{
+			const size_t m = inner->size();
+			std::vector<complex_type> buf(m);
+			for (size_t j = 0; j < n; ++j)
+				buf[j] = mul(data[j], chirp[j]);
+
+			inner->forward(buf.data());
+			for (size_t j = 0; j < m; ++j)
+				buf[j] = mul(buf[j], chirp_spectrum[j]);
+			inner->inverse(buf.data());
+
+			const T scale = T(1) / static_cast<T>(m);
+			for (size_t k = 0; k < n; ++k)
+				data[k] = mul(buf[k], chirp[k]) * scale;
+		}
+
+		size_t n;
+		std::vector<complex_type> twiddles;
+		std::vector<complex_type> chirp;
+		std::vector<complex_type> chirp_spectrum;
+		std::unique_ptr<basic_fft_plan> inner;
+	};
+
+	using fft_plan = basic_fft_plan<double>;
+
+	namespace detail
+	{
+		inline constexpr size_t batch_width = 16;
+
+		// rotation recurrences are re-seeded from sin/cos this often to bound rounding drift
+		inline constexpr size_t anchor_period = 64;
+
+		template<class T> struct is_complex : std::false_type {};
+		template<class T> struct is_complex<std::complex<T>> : std::true_type {};
+
+		// std::complex points convert directly, anything else goes through make_complex/make_value
+		template<class T, class C> std::complex<T> to_complex(C&& c)
+		{
+			if constexpr (is_complex<std::decay_t<C>>::value)
+				return { static_cast<T>(c.real()), static_cast<T>(c.imag()) };
+			else
+			{
+				const auto z = make_complex(std::forward<C>(c));
+				return { static_cast<T>(z.real()), static_cast<T>(z.imag()) };
+			}
+		}
+
+		template<class C, class T> C from_complex(const std::complex<T>& z)
+		{
+			if constexpr (is_complex<C>::value)
+				return { static_cast<typename C::value_type>(z.real()), static_cast<typename C::value_type>(z.imag()) };
+			else
+				return make_value<C>({ static_cast<double>(z.real()), static_cast<double>(z.imag()) });
+		}
+
+		// Harmonics stored as split real/imaginary arrays for the batch kernels.
+		template<class T> struct coeff_soa
+		{
+			void assign(const std::vector<std::pair<std::complex<T>, std::complex<T>>>& ab)
+			{
+				ar.resize(ab.size());
+				ai.resize(ab.size());
+				br.resize(ab.size());
+				bi.resize(ab.size());
+				for (size_t k = 0; k < ab.size(); ++k)
+				{
+					ar[k] = ab[k].first.real();
+					ai[k] = ab[k].first.imag();
+					br[k] = ab[k].second.real();
+					bi[k] = ab[k].second.imag();
+				}
+			}
+
+			size_t size() const noexcept
+			{
+				return ar.size();
+			}
+
+			std::vector<T> ar, ai, br, bi;
+		};
+
+		// Adds sum_k (a_k*cos(k*t) + b_k*sin(k*t)) over harmonics [first, last) to re/im for
+		// batch_width angles t at once, given cos/sin of t and of (first+1)*t;
+		// each lane runs its own rotation recurrence.
+		template<class T> FOURTD_TARGET_CLONES
+		inline void evaluate_batch(const coeff_soa<T>& c, size_t first, size_t last, const T* step_cos, const T* step_sin,
+			const T* start_cos, const T* start_sin, T* re, T* im) noexcept
+		{
+			const T* ar = c.ar.data();
+			const T* ai = c.ai.data();
+			const T* br = c.br.data();
+			const T* bi = c.bi.data();
+
+			T dc[batch_width], ds[batch_width], cs[batch_width], sn[batch_width];
+			T sum_re[batch_width] = {}, sum_im[batch_width] = {};
+			for (size_t j = 0; j < batch_width; ++j)
+			{
+				dc[j] = step_cos[j];
+				ds[j] = step_sin[j];
+				cs[j] = start_cos[j];
+				sn[j] = start_sin[j];
+			}
+
+			for (size_t k = first; k < last; ++k)
+			{
+				const T kar = ar[k], kai = ai[k], kbr = br[k], kbi = bi[k];
+				for (size_t j = 0; j < batch_width; ++j)
+				{
+					sum_re[j] += kar * cs[j] + kbr * sn[j];
+					sum_im[j] += kai * cs[j] + kbi * sn[j];
+					const T next_cos = cs[j] * dc[j] - sn[j] * ds[j];
+					sn[j] = sn[j] * dc[j] + cs[j] * ds[j];
+					cs[j] = next_cos;
+				}
+			}
+
+			for (size_t j = 0; j < batch_width; ++j)
+			{
+				re[j] += sum_re[j];
+				im[j] += sum_im[j];
+			}
+		}
+
+		// Same sweep as evaluate_batch, also accumulating the first and second derivative:
+		// with A_k = a_k*cos(k*t) + b_k*sin(k*t) and B_k = b_k*cos(k*t) - a_k*sin(k*t),
+		// f = sum A_k, f' = sum k*B_k, f'' = -sum k^2*A_k. out holds 6 rows of batch_width
+		// (value, first, second; real then imaginary).
+		template<class T> FOURTD_TARGET_CLONES
+		inline void evaluate_jet_batch(const coeff_soa<T>& c, size_t first, size_t last, const T* step_cos, const T* step_sin,
+			const T* start_cos, const T* start_sin, T* out) noexcept
+		{
+			const T* ar = c.ar.data();
+			const T* ai = c.ai.data();
+			const T* br = c.br.data();
+			const T* bi = c.bi.data();
+
+			T dc[batch_width], ds[batch_width], cs[batch_width], sn[batch_width];
+			T v_re[batch_width] = {}, v_im[batch_width] = {};
+			T d1_re[batch_width] = {}, d1_im[batch_width] = {};
+			T d2_re[batch_width] = {}, d2_im[batch_width] = {};
+			for (size_t j = 0; j < batch_width; ++j)
+			{
+				dc[j] = step_cos[j];
+				ds[j] = step_sin[j];
+				cs[j] = start_cos[j];
+				sn[j] = start_sin[j];
+			}
+
+			for (size_t k = first; k < last; ++k)
+			{
+				const T kar = ar[k], kai = ai[k], kbr = br[k], kbi = bi[k];
+				const T k1 = static_cast<T>(k + 1), k2 = k1 * k1;
+				for (size_t j = 0; j < batch_width; ++j)
+				{
+					const T a_re = kar * cs[j] + kbr * sn[j];
+					const T a_im = kai * cs[j] + kbi * sn[j];
+					const T b_re = kbr * cs[j] - kar * sn[j];
+					const T b_im = kbi * cs[j] - kai * sn[j];
+					v_re[j] += a_re;
+					v_im[j] += a_im;
+					d1_re[j] += k1 * b_re;
+					d1_im[j] += k1 * b_im;
+					d2_re[j] -= k2 * a_re;
+					d2_im[j] -= k2 * a_im;
+					const T next_cos = cs[j] * dc[j] - sn[j] * ds[j];
+					sn[j] = sn[j] * dc[j] + cs[j] * ds[j];
+					cs[j] = next_cos;
+				}
+			}
+
+			for (size_t j = 0; j < batch_width; ++j)
+			{
+				out[j] += v_re[j];
+				out[batch_width + j] += v_im[j];
+				out[2 * batch_width + j] += d1_re[j];
+				out[3 * batch_width + j] += d1_im[j];
+				out[4 * batch_width + j] += d2_re[j];
+				out[5 * batch_width + j] += d2_im[j];
+			}
+		}
+
+		// out[i] = a0 + the series c at angles[i], batch_width points at a time
+		template<class T> void evaluate_values(const coeff_soa<T>& c, const std::complex<T>& a0, const T* angles, size_t count, std::complex<T>* out)
+		{
+			T lane_angle[batch_width], step_cos[batch_width], step_sin[batch_width];
+			T start_cos[batch_width], start_sin[batch_width];
+			T re[batch_width], im[batch_width];
+			for (size_t i = 0; i < count; i += batch_width)
+			{
+				const size_t n = std::min(batch_width, count - i);
+				for (size_t j = 0; j < batch_width; ++j)
+				{
+					lane_angle[j] = j < n ? angles[i + j] : T(0);
+					start_cos[j] = step_cos[j] = std::cos(lane_angle[j]);
+					start_sin[j] = step_sin[j] = std::sin(lane_angle[j]);
+					re[j] = a0.real();
+					im[j] = a0.imag();
+				}
+
+				for (size_t k = 0; k < c.size(); k += anchor_period)
+				{
+					if (k != 0)
+					{
+						for (size_t j = 0; j < batch_width; ++j)
+						{
+							start_cos[j] = std::cos(static_cast<T>(k + 1) * lane_angle[j]);
+							start_sin[j] = std::sin(static_cast<T>(k + 1) * lane_angle[j]);
+						}
+					}
+					evaluate_batch(c, k, std::min(c.size(), k + anchor_period), step_cos, step_sin, start_cos, start_sin, re, im);
+				}
+
+				for (size_t j = 0; j < n; ++j)
+					out[i + j] = { re[j], im[j] };
+			}
+		}
+	}
+
+	class sliding_fourier;
+	class fourier_batch;
+	class curve_view;
+	class coeff_writer;
+	class coeff_stream_writer;
+	class coeff_file;
+	template<size_t M, class T = double> class fixed_fourier;
+
+	template<class T> class basic_fourier
 	{
+		friend class sliding_fourier;
+		friend class fourier_batch;
+		friend class curve_view;
+		friend class coeff_writer;
+		friend class coeff_stream_writer;
+		friend class coeff_file;
+		template<size_t, class> friend class fixed_fourier;
+
+	public:
+		using value_type = T;
+		using complex_type = std::complex<T>;
+		using fft_plan = basic_fft_plan<T>;
+
+	private:
+		static constexpr T pi = pi_v<T>;
 
-		static complex_double make_sincos(double start_angle)
+		// relative tolerances are picked for double and floored at a few ulps of T
+		static constexpr T relative(T tolerance) noexcept
 		{
-			return std::polar(1.0, start_angle);
+			return std::max(tolerance, 16 * std::numeric_limits<T>::epsilon());
 		}
 
+		static complex_type make_sincos(T start_angle)
+		{
+			return std::polar(T(1), start_angle);
+		}
+
+		// Walks e^(i*(start + n*delta)) by complex rotation, re-anchored from std::polar every
+		// detail::anchor_period steps, so the error stays bounded and jumps are O(1).
 		struct TrigonometricIterator
 		{
-			explicit TrigonometricIterator(const complex_double& start_sincos, double start_angle = {}) noexcept:
+			explicit TrigonometricIterator(const complex_type& start_sincos, T start_angle = {}) noexcept:
 				start_sincos(start_sincos),
-				cur_sincos(make_sincos(start_angle))
+				cur_sincos(make_sincos(start_angle)),
+				start_angle(start_angle),
+				delta_angle(std::arg(start_sincos))
 			{
 				step();
 			}
 
-			explicit TrigonometricIterator(double delta_angle, double start_angle = {}) noexcept :
+			explicit TrigonometricIterator(T delta_angle, T start_angle = {}) noexcept :
 				start_sincos(make_sincos(delta_angle)),
-				cur_sincos(make_sincos(start_angle))
+				cur_sincos(make_sincos(start_angle)),
+				start_angle(start_angle),
+				delta_angle(delta_angle)
 			{
 				step();
 			}
 
-			complex_double sincos() const noexcept
+			T angle() const noexcept
+			{
+				return start_angle + static_cast<T>(step_num) * delta_angle;
+			}
+
+			complex_type sincos() const noexcept
 			{
 				return cur_sincos;
 			}
 
-			double cos() const noexcept
+			T cos() const noexcept
 			{
 				return cur_sincos.real();
 			}
 
-			double sin() const noexcept
+			T sin() const noexcept
 			{
 				return cur_sincos.imag();
 			}
 
-			const complex_double& operator*() const noexcept
+			const complex_type& operator*() const noexcept
 			{
 				return cur_sincos;
 			}
 
-			const complex_double* operator->() const noexcept
+			const complex_type* operator->() const noexcept
 			{
 				return &cur_sincos;
 			}
 
 			void step() noexcept
 			{
+				if (++step_num % detail::anchor_period == 0)
+				{
+					cur_sincos = make_sincos(angle());
+					return;
+				}
+
 				cur_sincos =
 				{
 					start_sincos.real() * cur_sincos.real() - start_sincos.imag() * cur_sincos.imag(),
@@ -82,158 +471,284 @@ namespace fourtd
 				return it;
 			}
 
+			// a few rotations are cheaper than a polar() call
 			TrigonometricIterator& operator+=(size_t step_count)noexcept
 			{
-				while (step_count--)
-					step();
+				if (step_count <= 4)
+				{
+					while (step_count--)
+						step();
+					return *this;
+				}
+
+				step_num += step_count;
+				cur_sincos = make_sincos(angle());
 				return *this;
 			}
 
-			const complex_double start_sincos;
-			complex_double cur_sincos;
+			TrigonometricIterator operator+(size_t step_count) const noexcept
+			{
+				TrigonometricIterator it(*this);
+				return it += step_count;
+			}
+
+			const complex_type start_sincos;
+			complex_type cur_sincos;
+			const T start_angle;
+			const T delta_angle;
+			size_t step_num = 0;
 		};
-		using TrCoeff = std::pair<complex_double, complex_double>;
+		using TrCoeff = std::pair<complex_type, complex_type>;
 
-		fourier() = delete;
-		fourier(const fourier&) = delete;
-		fourier(fourier&&) = delete;
-		fourier& operator =(const fourier&) = delete;
-		fourier& operator =(fourier&&) = delete;
+		basic_fourier() = delete;
+		basic_fourier(const basic_fourier&) = delete;
+		basic_fourier(basic_fourier&&) = delete;
+		basic_fourier& operator =(const basic_fourier&) = delete;
+		basic_fourier& operator =(basic_fourier&&) = delete;
 
 	public:
 
-		double norma(double t, const complex_double& p0) const
+		T norma(T t, const complex_type& p0) const
 		{
-			complex_double d;
-			const auto val = nativ_value(t, [&d](const complex_double&, const TrCoeff& c, const complex_double& sincos, size_t k)
-				{
-					d = derivative_step(d, c, sincos, k);
-				}
-			) - p0;
-			return val.real() * d.real() + val.imag() * d.imag();
+			const auto j = nativ_jet(t);
+			const auto val = j.value - p0;
+			return val.real() * j.first.real() + val.imag() * j.first.imag();
+		}
+
+		// value and first two derivatives with respect to the angle
+		struct jet
+		{
+			complex_type value;
+			complex_type first;
+			complex_type second;
+		};
+
+		// one sweep over the harmonics for all three
+		jet nativ_jet(T angle) const
+		{
+			return sweep_jet(a0, ab, angle);
 		}
 
-		std::tuple<double, complex_double, double > lengthToPoint(const complex_double& test_pt) const
+		// out[i] = jet at angles[i]; evaluated detail::batch_width points at a time
+		void nativ_jets(const T* angles, size_t count, jet* out) const
 		{
-			std::vector<std::tuple<double, double, double, double>> ranges;
-			ranges.reserve(size);
-			const double delta = 2 * pi / size;
-			for (size_t i = 0; i < size; ++i)
-				ranges.emplace_back(0.0, std::numeric_limits<double>::max(), i * delta, (i + 1) * delta);
+			constexpr auto width = detail::batch_width;
+			T lane_angle[width], step_cos[width], step_sin[width], start_cos[width], start_sin[width];
+			T sums[6 * width];
+			for (size_t i = 0; i < count; i += width)
+			{
+				const size_t n = std::min(width, count - i);
+				std::fill(std::begin(sums), std::end(sums), 0.0);
+				for (size_t j = 0; j < width; ++j)
+				{
+					lane_angle[j] = j < n ? angles[i + j] : T(0);
+					start_cos[j] = step_cos[j] = std::cos(lane_angle[j]);
+					start_sin[j] = step_sin[j] = std::sin(lane_angle[j]);
+				}
 
-			std::for_each(std::execution::par_unseq, ranges.begin(), ranges.end(),
-				[this, &test_pt](auto &el)
+				for (size_t k = 0; k < soa.size(); k += detail::anchor_period)
 				{
-					static const double eps = 0.001;
-					double left_bound = std::get<2>(el);
-					double right_bound = std::get<3>(el);
-					double norma_left = norma(left_bound, test_pt);
-					auto norma_center = norma_left;
-					double center = -1.0;
-					while (std::abs(norma_center) > eps
-						&& std::abs(left_bound - right_bound) > eps)
+					if (k != 0)
 					{
-						center = (left_bound + right_bound) / 2.0;
-						norma_center = norma(center, test_pt);
-						if (norma_left * norma_center > 0)
-						{
-							left_bound = center;
-							norma_left = norma_center;
-						}
-						else
+						for (size_t j = 0; j < width; ++j)
 						{
-							right_bound = center;
+							start_cos[j] = std::cos(static_cast<T>(k + 1) * lane_angle[j]);
+							start_sin[j] = std::sin(static_cast<T>(k + 1) * lane_angle[j]);
 						}
 					}
+					detail::evaluate_jet_batch(soa, k, std::min(soa.size(), k + detail::anchor_period), step_cos, step_sin, start_cos, start_sin, sums);
+				}
 
-					const auto val = nativ_value(center);
-					std::get<0>(el) = std::abs(val - test_pt);
-					std::get<1>(el) = center;
+				for (size_t j = 0; j < n; ++j)
+				{
+					out[i + j] =
+					{
+						a0 + complex_type(sums[j], sums[width + j]),
+						{ sums[2 * width + j], sums[3 * width + j] },
+						{ sums[4 * width + j], sums[5 * width + j] }
+					};
 				}
-			);
+			}
+		}
+
+		// signed curvature at an index: Im(conj(f') * f'') / |f'|^3
+		T curvature(T idx) const
+		{
+			const auto j = nativ_jet(indexToAngle(idx));
+			const auto speed = std::abs(j.first);
+			return speed > 0.0 ? (std::conj(j.first) * j.second).imag() / (speed * speed * speed) : T(0);
+		}
+
+		// (angle, value, distance) of the curve point closest to a test point
+		using closest_point = std::tuple<T, complex_type, T>;
+
+		// Candidate spans come from a bounding-box hierarchy over a sampled polyline, built on
+		// first use after the coefficients change; Newton steps then refine each candidate.
+		closest_point lengthToPoint(const complex_type& test_pt) const
+		{
+			if (ab.empty())
+				return { 0.0, a0, std::abs(a0 - test_pt) };
+			return closest_to(*closest_tree(), test_pt);
+		}
+
+		std::vector<closest_point> lengthToPoints(const std::vector<complex_type>& test_pts) const
+		{
+			std::vector<closest_point> result(test_pts.size());
+			if (test_pts.empty()) return result;
 
-			const auto min_el = std::min_element(std::execution::par_unseq, ranges.cbegin(), ranges.cend());
-			const auto t = std::get<1>(*min_el);
-			const auto val = nativ_value(t);
-			return { t,val,std::abs(val - test_pt) };
+			const auto tree = ab.empty() ? nullptr : closest_tree();
+			workers().parallel_for(0, test_pts.size(), [this, &tree, &test_pts, &result](size_t first, size_t last)
+				{
+					for (; first != last; ++first)
+					{
+						const auto& pt = test_pts[first];
+						result[first] = tree ? closest_to(*tree, pt) : closest_point{ 0.0, a0, std::abs(a0 - pt) };
+					}
+				}, 16
+			);
+			return result;
 		}
 
-		double indexToAngle(double index) const noexcept
+		T indexToAngle(T index) const noexcept
 		{
 			return (1 + 2 * index) * pi / size;
 		}
 
-		double angleToIndex(double angle) const noexcept
+		T angleToIndex(T angle) const noexcept
 		{
-			return (angle * size / pi - 1.0) / 2.0;
+			return (angle * size / pi - 1) / 2;
 		}
 
 		template<class _FwdIt>
-		explicit fourier(_FwdIt _First, _FwdIt _Last)
+		explicit basic_fourier(_FwdIt _First, _FwdIt _Last)
 		{
 			calcul_coeff(_First, _Last);
 		}
 
-		template<class C> static complex_double make_complex(C&& c);
-		template<class C> static C make_value(const complex_double& z);
+		template<class _FwdIt>
+		basic_fourier(_FwdIt _First, _FwdIt _Last, size_t max_harmonics, T tolerance = 0.0)
+		{
+			calcul_coeff(_First, _Last, max_harmonics, tolerance);
+		}
+
 
-		double simpson(double a, double b, size_t size) const noexcept
+		T simpson(T a, T b, size_t size) const noexcept
 		{
-			const double delta = (b - a) / size;
-			const auto parts = std::thread::hardware_concurrency();
-			const double d2 = (b - a) / parts;
-			std::vector<std::future<double>> futures;
-			futures.reserve(parts);
-			for (std::size_t i = 0; i != parts; ++i)
-			{
-				const auto al = a + i * d2;
-				const auto bl = a + (i + 1) * d2;
+			const size_t pairs = std::max<size_t>(1, (size + 1) / 2);
+			const T delta = (b - a) / static_cast<T>(2 * pairs);
+			const size_t parts = std::max<size_t>(1, std::min<size_t>(workers().size(), pairs));
 
-				futures.emplace_back(std::async(
-					std::launch::async,
-					[this, al, bl, delta]
+			// *origin is the angle a; each part jumps straight to its first node
+			const TrigonometricIterator origin(delta, a - delta);
+			std::vector<T> sums(parts);
+			workers().parallel_for(0, parts, [this, &origin, &sums, pairs, parts](size_t part, size_t last_part)
+				{
+					for (; part != last_part; ++part)
 					{
-						double f1 = 0.0;
-						double f2 = 0.0;
-						TrigonometricIterator it(delta, al);
-						const double fs = std::abs(nativ_derivative_value(*it));
-						++it;
-						for (double t = al + delta; t < bl;)
+						const auto first = part * pairs / parts;
+						const auto last = (part + 1) * pairs / parts;
+						auto it = origin + 2 * first;
+						T left = std::abs(nativ_derivative_value(*it));
+						T sum = 0.0;
+						for (auto j = first; j != last; ++j)
 						{
-							f1 += std::abs(nativ_derivative_value(*it));
-							t += delta; 
 							++it;
-							f2 += std::abs(nativ_derivative_value(*it));
-							t += delta;
+							const T center = std::abs(nativ_derivative_value(*it));
 							++it;
+							const T right = std::abs(nativ_derivative_value(*it));
+							sum += left + 4 * center + right;
+							left = right;
 						}
-						return delta / 3 * (fs + 4 * f1 + 2 * f2);
+						sums[part] = sum;
 					}
-					)
-				);
+				}
+			);
+			return delta / 3 * std::accumulate(sums.begin(), sums.end(), T(0));
+		}
+
+		// Arc length between two indices. |f'| is sampled through the inverse FFT on L angles per
+		// period and its trigonometric interpolant integrated exactly over the span; on whole periods
+		// that is the trapezoid rule, which converges spectrally for the periodic integrand. L doubles
+		// until two successive refinements each change the estimate by at most max(eps, rel_eps * length).
+		T length(T a, T b, T eps = 0.1, T rel_eps = 0.0) const
+		{
+			if (ab.empty() || a == b) return {};
+			const auto start = indexToAngle(a);
+			const auto span = indexToAngle(b) - start;
+
+			size_t count = 16;
+			while (count < 2 * ab.size()) count *= 2;
+			const auto last = std::max(max_length_grid, 8 * count);
+
+			T estimate = interpolated_length(start, span, count);
+			int settled = 0;
+			while (count < last)
+			{
+				count *= 2;
+				const auto next = interpolated_length(start, span, count);
+				settled = std::abs(next - estimate) <= std::max(eps, rel_eps * std::abs(next)) ? settled + 1 : 0;
+				estimate = next;
+				if (settled == 2)
+					break;
 			}
-			return std::accumulate(futures.begin(), futures.end(), 0.0, [](const auto prev, auto& future) { return prev + future.get(); });
+			return estimate;
+		}
+
+		// Arc length from index 0 to idx, from a cumulative table built on first use after
+		// the coefficients change: O(1) per query.
+		T lengthAtParameter(T idx) const
+		{
+			if (size == 0) return {};
+			const auto table = arc_lengths();
+			const auto n = static_cast<T>(size);
+			const auto periods = std::floor(idx / n);
+			const auto rest = idx - periods * n;
+			const auto i = std::min(table->length.size() - 2, static_cast<size_t>(rest / table->step));
+			return periods * table->length.back() + table->length[i] + arc_segment(*table, i, rest - static_cast<T>(i) * table->step).first;
 		}
 
-		double length(double a, double b, double eps = 0.1) const noexcept
+		// Index at which the arc length from index 0 reaches s: O(log n) per query.
+		T parameterAtLength(T s) const
 		{
-			if (ab.empty()) return {};
-			a = indexToAngle(a);
-			b = indexToAngle(b);
-			size_t n = 20;
-			double first = simpson(a, b, n);
-			double second{};
-			do
+			if (size == 0) return {};
+			const auto table = arc_lengths();
+			const auto total = table->length.back();
+			if (total <= 0.0) return {};
+
+			const auto periods = std::floor(s / total);
+			const auto rest = s - periods * total;
+			const auto found = std::upper_bound(table->length.cbegin(), table->length.cend(), rest);
+			const auto i = std::min<size_t>(table->length.size() - 2, std::max<std::ptrdiff_t>(1, found - table->length.cbegin()) - 1);
+			const auto target = rest - table->length[i];
+			const auto d = table->length[i + 1] - table->length[i];
+
+			// Newton on the segment cubic, kept inside the bracket [lo, hi]
+			T lo = 0.0, hi = table->step;
+			T u = d > 0.0 ? std::clamp(target / d * table->step, lo, hi) : 0.0;
+			for (int iteration = 0; iteration < 32; ++iteration)
 			{
-				second = first;
-				n *= 2;
-				first = simpson(a, b, n);
-			} 
-			while (std::abs(first - second) > eps);
-			return first;
+				const auto [value, speed] = arc_segment(*table, i, u);
+				const auto error = value - target;
+				if (std::abs(error) <= relative(T(1e-12)) * total)
+					break;
+				(error > 0 ? hi : lo) = u;
+				const auto next = u - error / speed;
+				u = speed > 0.0 && next > lo && next < hi ? next : (lo + hi) / 2;
+			}
+			return periods * static_cast<T>(size) + static_cast<T>(i) * table->step + u;
+		}
+
+		T lengthBetween(T a, T b) const
+		{
+			return lengthAtParameter(b) - lengthAtParameter(a);
 		}
 
-		double square()const noexcept
+		T totalLength() const
+		{
+			return lengthAtParameter(static_cast<T>(size));
+		}
+
+		T square()const noexcept
 		{
 			if (square_value < 0.0)
 			{
@@ -241,8 +756,8 @@ namespace fourtd
 					std::accumulate(
 						ab.cbegin(),
 						ab.cend(),
-						0.0,
-						[](double square_value, const TrCoeff& c)
+						T(0),
+						[](T square_value, const TrCoeff& c)
 						{
 							return square_value + c.first.real() * c.second.imag() - c.first.imag() * c.second.real();
 						}));
@@ -252,127 +767,444 @@ namespace fourtd
 			return square_value;
 		}
 
-		template<class _FwdIt> void calcul_coeff(_FwdIt _First, _FwdIt _Last)
+		enum class coeff_method { automatic, direct, fft };
+
+		// below this many samples the direct sum is as cheap as the transform
+		static constexpr size_t fft_threshold = 16;
+
+		template<class _FwdIt> void calcul_coeff(_FwdIt _First, _FwdIt _Last, coeff_method method = coeff_method::automatic)
+		{
+			harmonic_limit = all_harmonics;
+			rms_tolerance = 0.0;
+			if (method == coeff_method::automatic)
+				method = static_cast<size_t>(std::distance(_First, _Last)) < fft_threshold ? coeff_method::direct : coeff_method::fft;
+
+			if (method == coeff_method::fft)
+				calcul_coeff_fft(_First, _Last);
+			else
+				calcul_coeff_direct(_First, _Last);
+		}
+
+		static constexpr size_t all_harmonics = std::numeric_limits<size_t>::max();
+
+		// Band-limited fit: keeps harmonics 1..M only, which is the least-squares best series of
+		// that order for equispaced samples. M is the smallest order whose RMS distance to the
+		// samples is within tolerance, and at most max_harmonics. Evaluation, length and
+		// closest-point queries then cost O(M) instead of O(N).
+		// The limit stays in force for insert_point and erase_point.
+		template<class _FwdIt> void calcul_coeff(_FwdIt _First, _FwdIt _Last, size_t max_harmonics, T tolerance = 0.0)
+		{
+			harmonic_limit = max_harmonics;
+			rms_tolerance = tolerance;
+			calcul_coeff_fft(_First, _Last);
+		}
+
+		// RMS distance between the samples and the series; zero unless the fit dropped harmonics
+		T residual() const noexcept
+		{
+			if (!is_truncated()) return 0.0;
+
+			// Parseval: what the kept harmonics do not carry of the mean sample energy
+			T kept = std::norm(a0);
+			for (const auto& c : ab)
+				kept += (std::norm(c.first) + std::norm(c.second)) / 2;
+			return std::sqrt(std::max(T(0), sample_energy - kept));
+		}
+
+		bool is_truncated() const noexcept
+		{
+			return ab.size() < size / 2;
+		}
+
+		template<class _FwdIt> void calcul_coeff_fft(_FwdIt _First, _FwdIt _Last)
+		{
+			std::vector<complex_type> samples;
+			for (; _First != _Last; ++_First)
+				samples.push_back(detail::to_complex<T>(*_First));
+
+			fit_samples(std::move(samples));
+		}
+
+		// Moving one sample adds a rank-one term to every coefficient: O(M) instead of a refit.
+		void update_point(size_t index, const complex_type& old_value, const complex_type& new_value)
+		{
+			if (index >= size) return;
+
+			const auto n = static_cast<T>(size);
+			const auto delta = new_value - old_value;
+			const auto d = delta * (2 / n);
+			a0 += delta / n;
+			sample_energy += (std::norm(new_value) - std::norm(old_value)) / n;
+
+			const size_t count = ab.size() - has_nyquist();
+			TrigonometricIterator it(make_sincos(indexToAngle(static_cast<T>(index))), 0.0);
+			T sum = 0.0;
+			for (size_t k = 0; k < count; ++k, ++it)
+			{
+				auto& c = ab[k];
+				c.first += d * it.cos();
+				c.second += d * it.sin();
+				sum += c.first.real() * c.second.imag() - c.first.imag() * c.second.real();
+			}
+
+			// Nyquist term: sin(N/2 * angle_j) = (-1)^j, cos(N/2 * angle_j) = 0
+			if (has_nyquist())
+				ab.back().second += (index % 2 == 0 ? delta : -delta) / n;
+
+			square_value = pi * std::abs(sum);
+			coeffs_changed();
+		}
+
+		// A new N moves every sample angle, so all coefficients change; the current
+		// samples are recovered from the series itself and refitted in O(N log N).
+		// After a band-limited fit the recovered samples lie on the truncated curve,
+		// so the detail the fit dropped is lost for good.
+		void insert_point(size_t index, const complex_type& value)
+		{
+			auto pts = samples();
+			pts.insert(pts.begin() + static_cast<std::ptrdiff_t>(std::min(index, pts.size())), value);
+			fit_samples(std::move(pts));
+		}
+
+		void erase_point(size_t index)
+		{
+			auto pts = samples();
+			if (index >= pts.size()) return;
+			pts.erase(pts.begin() + static_cast<std::ptrdiff_t>(index));
+			fit_samples(std::move(pts));
+		}
+
+		// the interpolated values at the N sample angles
+		std::vector<complex_type> samples() const
+		{
+			std::vector<complex_type> spectrum(size);
+			if (spectrum.empty()) return spectrum;
+
+			const auto n = static_cast<T>(size);
+			spectrum[0] = a0 * n;
+
+			const size_t count = ab.size() - has_nyquist();
+			for (size_t k = 1; k <= count; ++k)
+			{
+				const auto& c = ab[k - 1];
+				const auto w = make_sincos(static_cast<T>(k) * pi / n);
+				const auto ib = complex_type(-c.second.imag(), c.second.real());
+				spectrum[k] = w * (c.first - ib) * (n / 2);
+				spectrum[size - k] = std::conj(w) * (c.first + ib) * (n / 2);
+			}
+
+			if (has_nyquist())
+				spectrum[size / 2] = ab.back().second * n;
+
+			plan_for(size)->inverse(spectrum.data());
+			for (auto& z : spectrum)
+				z /= n;
+			return spectrum;
+		}
+
+		// O(N^2) reference path
+		template<class _FwdIt> void calcul_coeff_direct(_FwdIt _First, _FwdIt _Last)
 		{
 			ab.clear();
 			square_value = -1.0; //reset;
+			size = std::distance(_First, _Last);
+			a0 = {};
+			sample_energy = 0.0;
+			harmonic_limit = all_harmonics;
+			rms_tolerance = 0.0;
+			coeffs_changed();
 			if (_First == _Last) return;
 
-			size = std::distance(_First, _Last);
 			is_odd = size % 2 != 0;
 
-			a0 = {};
-			complex_double bn;
+			complex_type bn;
 
 			bool is_plus = true;
 
-			const auto _UBFirst = std::_Get_unwrapped(_First);
-			const auto _ULast = std::_Get_unwrapped(_Last);
-			for (auto _UFirst = _UBFirst; _UFirst != _ULast; ++_UFirst)
+			for (auto _UFirst = _First; _UFirst != _Last; ++_UFirst)
 			{
-				const auto z = make_complex(*_UFirst);
+				const auto z = detail::to_complex<T>(*_UFirst);
 				a0 += z;
+				sample_energy += std::norm(z);
 				bn += (is_plus ? z : -z);
 				is_plus = !is_plus;
 			}
 
-			a0 /= static_cast<double>(size);
-			bn /= static_cast<double>(size);
+			a0 /= static_cast<T>(size);
+			sample_energy /= static_cast<T>(size);
+			bn /= static_cast<T>(size);
 
-			const auto del = 2.0 / static_cast<double>(size);
-			const auto d_angle = pi / static_cast<double>(size);
+			const auto del = 2 / static_cast<T>(size);
+			const auto d_angle = pi / static_cast<T>(size);
 
 			TrigonometricIterator it(d_angle);
 
 			for (auto n = is_odd ? (size - 1) / 2 : size / 2 - 1; n--; ++it)
 			{
-				ab.emplace_back(*it, complex_double{});
+				ab.emplace_back(*it, complex_type{});
 			}
 
-			std::for_each(std::execution::par, ab.begin(), ab.end(),
-				[this, del, _UBFirst, _ULast](auto& el)
+			workers().parallel_for(0, ab.size(), [this, del, _First, _Last](size_t first, size_t last)
 				{
-					complex_double a, b;
-					TrigonometricIterator it(el.first);
-
-					for (auto _UFirst = _UBFirst; _UFirst != _ULast; ++_UFirst, it += 2)
+					for (; first != last; ++first)
 					{
-						const auto z = make_complex(*_UFirst);
-						a += z * it.cos();
-						b += z * it.sin();
+						auto& el = ab[first];
+						complex_type a, b;
+						TrigonometricIterator it(el.first);
+
+						for (auto _UFirst = _First; _UFirst != _Last; ++_UFirst, it += 2)
+						{
+							const auto z = detail::to_complex<T>(*_UFirst);
+							a += z * it.cos();
+							b += z * it.sin();
+						}
+						el.first = a * del;
+						el.second = b * del;
 					}
-					el.first = a * del;
-					el.second = b * del;
 				}
 			);
 
 			if (!is_odd)
-				ab.emplace_back(complex_double{}, bn);
+				ab.emplace_back(complex_type{}, bn);
 
+			coeffs_changed();
 		}
 
-		complex_double operator()(double t) const
+		complex_type operator()(T t) const
 		{
 			return value(t);
 		}
 
-		template<typename GetFun, typename CalculFun> void values_impl(GetFun&& get_fun, CalculFun&& calc_fun, double a, double b, double delta) const
+		template<typename GetFun, typename CalculFun> void values_impl(GetFun&& get_fun, CalculFun&& calc_fun, T a, T b, T delta) const
 		{
 			const auto local_a = indexToAngle(a);
 			const auto local_b = indexToAngle(b);
 			const auto local_delta = 2 * delta * pi / size;
 			TrigonometricIterator it(local_delta, local_a);
 
-			for (double t = local_a; t < local_b; t += local_delta, ++it)
+			for (T t = local_a; t < local_b; t += local_delta, ++it)
 			{
 				get_fun(calc_fun(*it));
 			}
 		}
 
-		template<typename C, typename OutIt> void values(OutIt it, double a, double b, double delta = 0.01) const
+		template<typename C, typename OutIt> void values(OutIt it, T a, T b, T delta = 0.01) const
 		{
-			values_impl
-			(
-				[&it](const complex_double& v) {*it = make_value<C>(v); ++it; }
-				, [this](const complex_double& start_sincos)
-				{
-					return single_nativ_value_it(start_sincos);
-				}
-			, a, b, delta);
-		}
+			const auto local_a = indexToAngle(a);
+			const auto local_b = indexToAngle(b);
+			const auto local_delta = 2 * delta * pi / size;
 
-		const auto& coeffs() const
+			if (size == 0) return;
+
+			// K equispaced outputs on a grid of L = 2*pi/delta points per period are one inverse FFT
+			const size_t total = sample_count(local_a, local_b, local_delta);
+			const auto period = std::round(2 * pi / local_delta);
+			if (period >= 1.0 && std::abs(2 * pi / local_delta - period) < relative(T(1e-9)) * period
+				&& prefer_dense(total, static_cast<size_t>(period)))
+			{
+				const auto dense = dense_values(local_a, static_cast<size_t>(period));
+				for (size_t i = 0; i < total; ++i, ++it)
+					*it = detail::from_complex<C>(dense[i % dense.size()]);
+				return;
+			}
+
+			emit_values<C>(it, local_a, local_delta, total, [this](const T* angles, size_t count, complex_type* out)
+				{
+					nativ_values(angles, count, out);
+				}
+			);
+		}
+
+		// Polyline over the indices [a, b] whose chords stay within tolerance of the curve, in the
+		// units of the points; few points on flat stretches, many in tight turns.
+		template<typename C, typename OutIt> void tessellate(OutIt it, T a, T b, T tolerance) const
+		{
+			if (size == 0) return;
+			tessellate_series<C>(it, a0, ab, indexToAngle(a), indexToAngle(b), tolerance);
+		}
+
+		// count values over one period, the m-th at index m*N/count
+		std::vector<complex_type> resample(size_t count) const
+		{
+			if (count == 0 || size == 0) return {};
+			return dense_values(indexToAngle(0.0), count);
+		}
+
+		// out[i] = value at angles[i]; evaluated detail::batch_width points at a time
+		void nativ_values(const T* angles, size_t count, complex_type* out) const
+		{
+			detail::evaluate_values(soa, a0, angles, count, out);
+		}
+
+		const auto& coeffs() const
 		{
 			return ab;
 		}
 
+		// Level-of-detail view: a0 plus a subset of the harmonics. Dropping harmonic k removes the
+		// epicycles z1*e^(ik*angle) and z2*e^(-ik*angle), which move no point by more than
+		// |z1| + |z2|, so the view stays within error_bound() of the full curve.
+		class sub_series
+		{
+		public:
+			complex_type nativ_value(T angle) const
+			{
+				auto sum = a0;
+				TrigonometricIterator it(make_sincos(angle), 0.0);
+				for (const auto& c : ab)
+				{
+					sum += c.first * it.cos() + c.second * it.sin();
+					++it;
+				}
+				return sum;
+			}
+
+			void nativ_values(const T* angles, size_t count, complex_type* out) const
+			{
+				detail::evaluate_values(soa, a0, angles, count, out);
+			}
+
+			complex_type value(T idx) const
+			{
+				return nativ_value((1 + 2 * idx) * pi / size);
+			}
+
+			template<typename C, typename OutIt> void values(OutIt it, T a, T b, T delta = 0.01) const
+			{
+				if (size == 0) return;
+				const auto local_a = (1 + 2 * a) * pi / size;
+				const auto local_b = (1 + 2 * b) * pi / size;
+				const auto local_delta = 2 * delta * pi / size;
+
+				emit_values<C>(it, local_a, local_delta, sample_count(local_a, local_b, local_delta), [this](const T* angles, size_t count, complex_type* out)
+					{
+						nativ_values(angles, count, out);
+					}
+				);
+			}
+
+			template<typename C, typename OutIt> void tessellate(OutIt it, T a, T b, T tolerance) const
+			{
+				if (size == 0) return;
+				tessellate_series<C>(it, a0, ab, (1 + 2 * a) * pi / size, (1 + 2 * b) * pi / size, tolerance);
+			}
+
+			T error_bound() const noexcept
+			{
+				return bound;
+			}
+
+			// harmonics kept; evaluation costs O(highest kept harmonic)
+			size_t terms() const noexcept
+			{
+				return term_count;
+			}
+
+		private:
+			friend class basic_fourier;
+
+			void assign(std::vector<TrCoeff>&& coeffs)
+			{
+				ab = std::move(coeffs);
+				soa.assign(ab);
+			}
+
+			complex_type a0;
+			std::vector<TrCoeff> ab;
+			detail::coeff_soa<T> soa;
+			size_t size{};
+			size_t term_count{};
+			T bound{};
+		};
+
+		// harmonics 1..harmonics
+		sub_series prefix(size_t harmonics) const
+		{
+			harmonics = std::min(harmonics, ab.size());
+			sub_series result;
+			result.a0 = a0;
+			result.size = size;
+			result.term_count = harmonics;
+			result.bound = tail_bound[harmonics];
+			result.assign({ ab.cbegin(), ab.cbegin() + static_cast<std::ptrdiff_t>(harmonics) });
+			return result;
+		}
+
+		// the terms harmonics with the largest radii, which minimizes the bound for that many terms
+		sub_series ranked(size_t terms) const
+		{
+			std::vector<std::pair<T, size_t>> order(ab.size());
+			for (size_t k = 0; k < ab.size(); ++k)
+				order[k] = { tail_bound[k] - tail_bound[k + 1], k };
+			terms = std::min(terms, order.size());
+			std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(terms), order.end(), std::greater<>());
+
+			sub_series result;
+			result.a0 = a0;
+			result.size = size;
+			result.term_count = terms;
+			result.bound = std::accumulate(order.cbegin() + static_cast<std::ptrdiff_t>(terms), order.cend(), T(0),
+				[](T sum, const std::pair<T, size_t>& o) { return sum + o.first; });
+
+			size_t highest = 0;
+			for (size_t i = 0; i < terms; ++i)
+				highest = std::max(highest, order[i].second + 1);
+			std::vector<TrCoeff> coeffs(highest);
+			for (size_t i = 0; i < terms; ++i)
+				coeffs[order[i].second] = ab[order[i].second];
+			result.assign(std::move(coeffs));
+			return result;
+		}
+
+		// fewest leading harmonics whose dropped tail stays within tolerance: O(log M)
+		size_t lodForTolerance(T tolerance) const
+		{
+			return static_cast<size_t>(std::partition_point(tail_bound.cbegin(), tail_bound.cend(), [tolerance](T tail) { return tail > tolerance; }) - tail_bound.cbegin());
+		}
+
+		sub_series lod(T tolerance) const
+		{
+			return prefix(lodForTolerance(tolerance));
+		}
+
+		// simpson, lengthToPoint and calcul_coeff run on this pool; thread_pool::shared() unless set
+		thread_pool& workers() const noexcept
+		{
+			return pool ? *pool : thread_pool::shared();
+		}
+
+		void set_workers(thread_pool& workers) noexcept
+		{
+			pool = &workers;
+		}
+
 		const auto& firstCoeff() const
 		{
 			return a0;
 		}
 
-		complex_double value(double idx) const
+		complex_type value(T idx) const
 		{
 			return nativ_value(indexToAngle(idx));
 		}
 
-		complex_double derivative_value(double idx) const
+		complex_type derivative_value(T idx) const
 		{
 			return nativ_derivative_value(make_sincos(indexToAngle(idx)));
 		}
 
-		static complex_double fun_step(const complex_double& sum, const TrCoeff& c, const complex_double& sincos, size_t)
+		static complex_type fun_step(const complex_type& sum, const TrCoeff& c, const complex_type& sincos, size_t)
 		{
 			return sum + c.first * sincos.real() + c.second * sincos.imag();
 		}
 
-		static complex_double derivative_step(const complex_double& sum, const TrCoeff& c, const complex_double& sincos, size_t it_num)
+		static complex_type derivative_step(const complex_type& sum, const TrCoeff& c, const complex_type& sincos, size_t it_num)
 		{
-			return sum + (-c.first * sincos.imag() + c.second * sincos.real()) * static_cast<double>(it_num);
+			return sum + (-c.first * sincos.imag() + c.second * sincos.real()) * static_cast<T>(it_num);
 		}
 
 		template<typename MainFun, typename ... Funs>
-		complex_double forEach(const complex_double& start, const complex_double& start_sincos, MainFun&& main_fun, Funs &&... funs) const
+		complex_type forEach(const complex_type& start, const complex_type& start_sincos, MainFun&& main_fun, Funs &&... funs) const
 		{
 			auto sum = start;
 
@@ -380,7 +1212,7 @@ namespace fourtd
 			size_t k = 1;
 			for (const auto& c : ab)
 			{
-				((funs(static_cast<const complex_double&>(sum), c, *it, k)), ...);
+				((funs(static_cast<const complex_type&>(sum), c, *it, k)), ...);
 				sum = main_fun(sum, c, *it, k);
 				++it;
 				++k;
@@ -389,34 +1221,670 @@ namespace fourtd
 		}
 
 		template<typename ... Funs>
-		complex_double nativ_derivative_value(const complex_double& start_sincos, Funs&&... funs) const
+		complex_type nativ_derivative_value(const complex_type& start_sincos, Funs&&... funs) const
 		{
-			return forEach({}, start_sincos, &fourier::derivative_step, std::decay_t<Funs>(std::forward<Funs>(funs))...);
+			return forEach({}, start_sincos, &basic_fourier::derivative_step, std::decay_t<Funs>(std::forward<Funs>(funs))...);
 		}
 
 
 		template<typename ... Funs>
-		complex_double nativ_value_it(const complex_double& start_sincos, Funs&&... funs) const
+		complex_type nativ_value_it(const complex_type& start_sincos, Funs&&... funs) const
 		{
-			return forEach(a0, start_sincos, &fourier::fun_step, std::decay_t<Funs>(std::forward<Funs>(funs))...);
+			return forEach(a0, start_sincos, &basic_fourier::fun_step, std::decay_t<Funs>(std::forward<Funs>(funs))...);
 		}
 
-		complex_double single_nativ_value_it(const complex_double& start_sincos) const
+		complex_type single_nativ_value_it(const complex_type& start_sincos) const
 		{
 			return nativ_value_it(start_sincos);
 		}
 
 		template<typename ... Funs>
-		complex_double nativ_value(double angle, Funs&&... funs) const
+		complex_type nativ_value(T angle, Funs&&... funs) const
 		{
 			return nativ_value_it<Funs...>(make_sincos(angle), std::decay_t<Funs>(std::forward<Funs>(funs))...);
 		}
 
 	private:
-		complex_double a0;
+		// length() stops refining at this many speeds per period, or three doublings past its start
+		static constexpr size_t max_length_grid = size_t(1) << 20;
+
+		// samples already in complex form, for front ends that keep their own spectrum
+		basic_fourier(std::vector<complex_type>&& samples, size_t max_harmonics)
+		{
+			harmonic_limit = max_harmonics;
+			fit_samples(std::move(samples));
+		}
+
+		// number of angles start + i*step below end, counted in closed form: summing a float step
+		// drifts and stalls once t + step == t
+		static size_t sample_count(T start, T end, T step) noexcept
+		{
+			using wide = std::common_type_t<T, double>;
+			if (!(end > start) || !(step > 0)) return 0;
+			return static_cast<size_t>(std::ceil((static_cast<wide>(end) - static_cast<wide>(start)) / static_cast<wide>(step)));
+		}
+
+		// writes total values at start + i*step, evaluated through eval detail::batch_width at a time
+		template<typename C, typename OutIt, typename Eval> static void emit_values(OutIt& it, T start, T step, size_t total, Eval&& eval)
+		{
+			T angles[detail::batch_width];
+			complex_type batch[detail::batch_width];
+			size_t count = 0;
+			const auto flush = [&]
+			{
+				if (count == 0) return;
+				eval(angles, count, batch);
+				for (size_t i = 0; i < count; ++i, ++it)
+					*it = detail::from_complex<C>(batch[i]);
+				count = 0;
+			};
+
+			for (size_t i = 0; i < total; ++i)
+			{
+				angles[count++] = start + static_cast<T>(i) * step;
+				if (count == detail::batch_width)
+					flush();
+			}
+			flush();
+		}
+
+		static jet sweep_jet(const complex_type& a0, const std::vector<TrCoeff>& ab, T angle)
+		{
+			jet result{ a0, {}, {} };
+			TrigonometricIterator it(make_sincos(angle), 0.0);
+			T k = 1;
+			for (const auto& c : ab)
+			{
+				const auto a = c.first * it.cos() + c.second * it.sin();
+				const auto b = c.second * it.cos() - c.first * it.sin();
+				result.value += a;
+				result.first += b * k;
+				result.second -= a * (k * k);
+				++it;
+				k += 1;
+			}
+			return result;
+		}
+
+		// Steps along [start, end] by the arc over which the osculating circle leaves its chord by
+		// tolerance, curvature*s^2 = 8*tolerance. A step is shortened until the curvature at its
+		// middle and far end allows it too and the middle point lies within tolerance of the chord;
+		// it never spans more than a quarter period of the highest harmonic, so no turn fits
+		// between two points unseen.
+		template<typename C, typename OutIt>
+		static void tessellate_series(OutIt& it, const complex_type& a0, const std::vector<TrCoeff>& ab, T start, T end, T tolerance)
+		{
+			if (!(end > start)) return;
+			const auto max_step = ab.empty() ? end - start : std::min(end - start, pi / (2 * static_cast<T>(ab.size())));
+			const auto min_step = (end - start) / 65536;
+			const auto allowed = [tolerance, max_step, min_step](const jet& j)
+			{
+				const auto speed = std::abs(j.first);
+				const auto bend = std::abs((std::conj(j.first) * j.second).imag());
+				// curvature is bend/speed^3 and the step in angle is s/speed
+				if (!(speed > 0) || bend * max_step * max_step <= 8 * tolerance * speed)
+					return max_step;
+				return std::max(min_step, std::sqrt(8 * tolerance * speed / bend));
+			};
+
+			auto cur = sweep_jet(a0, ab, start);
+			*it = detail::from_complex<C>(cur.value);
+			++it;
+			for (T t = start; t < end;)
+			{
+				auto step = std::min(allowed(cur), end - t);
+				auto next = sweep_jet(a0, ab, t + step);
+				for (int tries = 0; tries < 8 && step > min_step; ++tries)
+				{
+					const auto mid = sweep_jet(a0, ab, t + step / 2);
+					const auto chord = next.value - cur.value;
+					const auto off = std::abs((std::conj(chord) * (mid.value - cur.value)).imag());
+					const auto shorter = std::min({ allowed(mid), allowed(next), off > tolerance * std::abs(chord) ? step / 2 : step });
+					if (shorter >= step)
+						break;
+					step = std::max(shorter, min_step);
+					next = sweep_jet(a0, ab, t + step);
+				}
+				t = step < end - t ? t + step : end;
+				cur = next;
+				*it = detail::from_complex<C>(cur.value);
+				++it;
+			}
+		}
+
+		// Integral over [start, start + span] of the trigonometric interpolant of |f'| at the count
+		// angles start + 2*pi*j/count. With X the DFT of those speeds the interpolant is
+		// sum_k X_k/count * e^(ik(angle - start)), and |f'| is real, so X_(count-k) = conj(X_k).
+		T interpolated_length(T start, T span, size_t count) const
+		{
+			auto speed = dense_values(start, count, true);
+			for (auto& z : speed)
+				z = std::abs(z);
+			plan_for(count)->forward(speed.data());
+
+			const auto n = static_cast<T>(count);
+			T sum = speed[0].real() / n * span;
+			TrigonometricIterator w(span);
+			for (size_t k = 1; 2 * k < count; ++k, ++w)
+			{
+				// the integral of e^(ikx) over [0, span] is (e^(ik*span) - 1) / (ik)
+				const auto integral = complex_type(w->imag(), 1 - w->real()) / static_cast<T>(k);
+				sum += 2 * (speed[k].real() * integral.real() - speed[k].imag() * integral.imag()) / n;
+			}
+			if (count % 2 == 0)
+			{
+				// the Nyquist term is a cosine
+				const auto k = static_cast<T>(count / 2);
+				sum += speed[count / 2].real() / n * std::sin(k * span) / k;
+			}
+			return sum;
+		}
+
+		// Cumulative arc length at parameter nodes i*step (index units) over one period, with the
+		// speed ds/d(index) at each node for cubic Hermite interpolation between them.
+		struct arc_table
+		{
+			T step;
+			std::vector<T> length;
+			std::vector<T> speed;
+		};
+
+		std::shared_ptr<const arc_table> arc_lengths() const
+		{
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			if (!arc)
+				arc = make_arc_table();
+			return arc;
+		}
+
+		std::shared_ptr<const arc_table> make_arc_table() const
+		{
+			auto table = std::make_shared<arc_table>();
+			size_t nodes = 64;
+			while (nodes < 16 * (ab.size() + 1)) nodes *= 2;
+			const auto h = static_cast<T>(size) / static_cast<T>(nodes);
+			const auto scale = 2 * pi / static_cast<T>(size);
+			table->step = h;
+
+			// speeds on the quarter-step grid, from one inverse FFT over the period; Simpson's rule on
+			// one and on two panels per segment
+			const auto derivative = dense_values(indexToAngle(0.0), 4 * nodes, true);
+			std::vector<T> quarter(4 * nodes + 1);
+			std::transform(derivative.cbegin(), derivative.cend(), quarter.begin(), [](const complex_type& z) { return std::abs(z); });
+			quarter.back() = quarter.front();
+			// per segment; the Hermite cubic between the nodes is no closer than that anyway
+			const auto tolerance = relative(T(1e-8)) * h * std::accumulate(quarter.begin(), quarter.end(), T(0)) * scale / 4;
+
+			std::vector<T> segment(nodes);
+			workers().parallel_for(0, nodes, [this, &quarter, &segment, h, scale, tolerance](size_t first, size_t last)
+				{
+					for (; first != last; ++first)
+					{
+						const auto v = &quarter[4 * first];
+						const auto whole = h / 6 * (v[0] + 4 * v[2] + v[4]) * scale;
+						const auto left = h / 12 * (v[0] + 4 * v[1] + v[2]) * scale;
+						const auto right = h / 12 * (v[2] + 4 * v[3] + v[4]) * scale;
+						segment[first] = std::abs(left + right - whole) <= 15 * tolerance
+							? left + right + (left + right - whole) / 15
+							: refined_length(indexToAngle(h * static_cast<T>(first)), h * scale, v, left + right, tolerance);
+					}
+				}, 64
+			);
+
+			table->length.resize(nodes + 1);
+			table->speed.resize(nodes + 1);
+			for (size_t i = 0; i <= nodes; ++i)
+			{
+				table->speed[i] = quarter[4 * i] * scale;
+				if (i != 0)
+					table->length[i] = table->length[i - 1] + segment[i - 1];
+			}
+			return table;
+		}
+
+		// Composite Simpson over the span from start, where |f'| has kinks: the panels halve until two
+		// estimates differ by at most 15*tolerance. speed holds the five speeds of the first four
+		// panels, estimate their sum; each level's new midpoints are evaluated in one nativ_jets batch.
+		T refined_length(T start, T span, const T* speed, T estimate, T tolerance) const
+		{
+			std::vector<T> speeds(speed, speed + 5), next;
+			std::vector<T> angles;
+			std::vector<jet> jets;
+			for (size_t panels = 4; panels < max_refined_panels; panels *= 2)
+			{
+				const auto step = span / static_cast<T>(panels);
+				angles.resize(panels);
+				jets.resize(panels);
+				for (size_t i = 0; i < panels; ++i)
+					angles[i] = start + (static_cast<T>(i) + T(0.5)) * step;
+				nativ_jets(angles.data(), panels, jets.data());
+
+				next.resize(2 * panels + 1);
+				T sum = speeds[0] + speeds[panels];
+				for (size_t i = 0; i < panels; ++i)
+				{
+					next[2 * i] = speeds[i];
+					next[2 * i + 1] = std::abs(jets[i].first);
+					sum += 4 * next[2 * i + 1] + (i != 0 ? 2 * speeds[i] : T(0));
+				}
+				next[2 * panels] = speeds[panels];
+				speeds.swap(next);
+
+				const auto refined = sum * step / 6;
+				if (std::abs(refined - estimate) <= 15 * tolerance)
+					return refined + (refined - estimate) / 15;
+				estimate = refined;
+			}
+			return estimate;
+		}
+
+		static constexpr size_t max_refined_panels = size_t(1) << 12;
+
+		// length from node i to i + u along the Hermite cubic, and its derivative
+		static std::pair<T, T> arc_segment(const arc_table& table, size_t i, T u) noexcept
+		{
+			const auto h = table.step;
+			const auto v0 = table.speed[i];
+			const auto v1 = table.speed[i + 1];
+			const auto d = table.length[i + 1] - table.length[i];
+			const auto c2 = 3 * d / (h * h) - (2 * v0 + v1) / h;
+			const auto c3 = (v0 + v1) / (h * h) - 2 * d / (h * h * h);
+			return { ((c3 * u + c2) * u + v0) * u, (3 * c3 * u + 2 * c2) * u + v0 };
+		}
+
+		// Polyline through the curve at equal angle steps. Every segment's box is widened by twice
+		// the curve's deviation from the chord at its midpoint, so the box distance is a lower
+		// bound for the curve span; levels[0] holds the segments, each next level unites pairs.
+		struct polyline_tree
+		{
+			struct box
+			{
+				T min_x, min_y, max_x, max_y;
+
+				T distance2(const complex_type& p) const noexcept
+				{
+					const auto dx = std::max({ min_x - p.real(), T(0), p.real() - max_x });
+					const auto dy = std::max({ min_y - p.imag(), T(0), p.imag() - max_y });
+					return dx * dx + dy * dy;
+				}
+
+				box operator|(const box& other) const noexcept
+				{
+					return { std::min(min_x, other.min_x), std::min(min_y, other.min_y), std::max(max_x, other.max_x), std::max(max_y, other.max_y) };
+				}
+			};
+
+			T step;
+			// the nodes lie on a coarse sub-series at most this far from the curve
+			T bound;
+			std::vector<complex_type> nodes;
+			std::vector<T> slack;
+			std::vector<std::vector<box>> levels;
+		};
+
+		std::shared_ptr<const polyline_tree> closest_tree() const
+		{
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			if (!tree)
+				tree = make_closest_tree();
+			return tree;
+		}
+
+		std::shared_ptr<const polyline_tree> make_closest_tree() const
+		{
+			auto result = std::make_shared<polyline_tree>();
+			const size_t count = std::max<size_t>(64, 8 * (ab.size() + 1));
+			result->step = 2 * pi / static_cast<T>(count);
+
+			// The node spacing still follows the full series, so Newton starts stay close, but the
+			// nodes come from the leading harmonics. The boxes grow by the dropped tail's bound,
+			// kept near the chord length (the total radius bounds the curve's extent) to stay tight.
+			const auto coarse = lod(tail_bound[0] / static_cast<T>(count));
+			result->bound = coarse.error_bound();
+
+			// nodes at even, chord midpoints at odd positions
+			std::vector<T> angles(2 * count);
+			for (size_t i = 0; i < angles.size(); ++i)
+				angles[i] = static_cast<T>(i) * result->step / 2;
+			std::vector<complex_type> points(angles.size());
+			workers().parallel_for(0, angles.size(), [&coarse, &angles, &points](size_t first, size_t last)
+				{
+					coarse.nativ_values(&angles[first], last - first, &points[first]);
+				}, 256
+			);
+
+			result->nodes.resize(count + 1);
+			result->slack.resize(count);
+			std::vector<typename polyline_tree::box> leaves(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto& p0 = points[2 * i];
+				const auto& p1 = points[(2 * i + 2) % points.size()];
+				const auto slack = 2 * std::abs(points[2 * i + 1] - (p0 + p1) / T(2)) + result->bound;
+				result->nodes[i] = p0;
+				result->slack[i] = slack;
+				leaves[i] =
+				{
+					std::min(p0.real(), p1.real()) - slack, std::min(p0.imag(), p1.imag()) - slack,
+					std::max(p0.real(), p1.real()) + slack, std::max(p0.imag(), p1.imag()) + slack
+				};
+			}
+			result->nodes[count] = result->nodes[0];
+
+			result->levels.push_back(std::move(leaves));
+			while (result->levels.back().size() > 1)
+			{
+				const auto& below = result->levels.back();
+				std::vector<typename polyline_tree::box> level((below.size() + 1) / 2);
+				for (size_t i = 0; i < level.size(); ++i)
+					level[i] = 2 * i + 1 < below.size() ? below[2 * i] | below[2 * i + 1] : below[2 * i];
+				result->levels.push_back(std::move(level));
+			}
+			return result;
+		}
+
+		closest_point closest_to(const polyline_tree& tree, const complex_type& test_pt) const
+		{
+			// best-first descent; the curve passes within tree.bound of the nodes, which bounds the answer from above
+			struct entry
+			{
+				T bound;
+				size_t level;
+				size_t index;
+				bool operator<(const entry& other) const noexcept { return bound > other.bound; }
+			};
+			std::vector<entry> heap{ { tree.levels.back()[0].distance2(test_pt), tree.levels.size() - 1, 0 } };
+			std::vector<std::pair<T, size_t>> candidates;
+			T best = std::numeric_limits<T>::max();
+			while (!heap.empty() && heap.front().bound <= best)
+			{
+				std::pop_heap(heap.begin(), heap.end());
+				const auto e = heap.back();
+				heap.pop_back();
+				if (e.level == 0)
+				{
+					const auto& p0 = tree.nodes[e.index];
+					const auto& p1 = tree.nodes[e.index + 1];
+					const auto reach = std::min(std::abs(p0 - test_pt), std::abs(p1 - test_pt)) + tree.bound;
+					best = std::min(best, reach * reach);
+					candidates.emplace_back(e.bound, e.index);
+					continue;
+				}
+
+				const auto& below = tree.levels[e.level - 1];
+				for (auto child = 2 * e.index; child < std::min(below.size(), 2 * e.index + 2); ++child)
+				{
+					heap.push_back({ below[child].distance2(test_pt), e.level - 1, child });
+					std::push_heap(heap.begin(), heap.end());
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end());
+			closest_point result{ 0.0, a0, std::numeric_limits<T>::max() };
+			for (const auto& [bound, index] : candidates)
+			{
+				if (bound > best) break;
+
+				// start from the projection onto the chord
+				const auto& p0 = tree.nodes[index];
+				const auto chord = tree.nodes[index + 1] - p0;
+				const auto chord2 = std::norm(chord);
+				const auto u = chord2 > 0 ? std::clamp(((test_pt - p0) * std::conj(chord)).real() / chord2, T(0), T(1)) : T(0);
+				const auto refined = refine_closest(test_pt, (static_cast<T>(index) + u) * tree.step, tree.step);
+				const auto distance2 = std::norm(std::get<1>(refined) - test_pt);
+				if (distance2 < std::get<2>(result))
+				{
+					result = refined;
+					std::get<2>(result) = distance2;
+				}
+				best = std::min(best, distance2);
+			}
+
+			std::get<2>(result) = std::sqrt(std::get<2>(result));
+			return result;
+		}
+
+		// Newton on g(t) = Re(conj(f - p) * f'), whose roots are the stationary distances
+		closest_point refine_closest(const complex_type& test_pt, T angle, T span) const
+		{
+			const auto start = angle;
+			const auto start_value = nativ_value(angle);
+			auto value = start_value;
+			for (int iteration = 0; iteration < 16; ++iteration)
+			{
+				const auto j = nativ_jet(angle);
+				value = j.value;
+				const auto r = value - test_pt;
+				const auto g = (std::conj(r) * j.first).real();
+				const auto dg = std::norm(j.first) + (std::conj(r) * j.second).real();
+				if (dg <= 0.0) break;
+
+				const auto step = std::clamp(-g / dg, -span, span);
+				angle = std::clamp(angle + step, start - 2 * span, start + 2 * span);
+				if (std::abs(step) < relative(T(1e-14)) * (1 + std::abs(angle))) break;
+			}
+			value = nativ_value(angle);
+
+			if (std::norm(start_value - test_pt) < std::norm(value - test_pt))
+			{
+				angle = start;
+				value = start_value;
+			}
+			angle -= 2 * pi * std::floor(angle / (2 * pi));
+			return { angle, value, std::abs(value - test_pt) };
+		}
+
+		void coeffs_changed()
+		{
+			soa.assign(ab);
+
+			// tail_bound[m]: sum of |z1_k| + |z2_k| over the harmonics k > m
+			tail_bound.assign(ab.size() + 1, 0.0);
+			for (size_t k = ab.size(); k--;)
+			{
+				const auto& c = ab[k];
+				const auto ib = complex_type(-c.second.imag(), c.second.real());
+				tail_bound[k] = tail_bound[k + 1] + (std::abs(c.first - ib) + std::abs(c.first + ib)) / 2;
+			}
+
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			arc.reset();
+			tree.reset();
+		}
+
+		// the inverse FFT pays off once the direct cost K*M outgrows the transforms
+		bool prefer_dense(size_t count, size_t period) const noexcept
+		{
+			return static_cast<T>(count) * static_cast<T>(ab.size()) > dense_cost(period, dense_grid(period));
+		}
+
+		// cost of dense_values(count) on transforms of length, counted in direct term evaluations:
+		// a Bluestein transform runs about a dozen times slower than a radix-2 one of the same length
+		T dense_cost(size_t count, size_t length) const noexcept
+		{
+			const auto n = static_cast<T>(count);
+			if (length == count && (count & (count - 1)) != 0)
+				return bluestein_cost * n * std::log2(n);
+			return n * std::log2(static_cast<T>(length) + 1) + fold_cost * static_cast<T>(count / length * ab.size());
+		}
+
+		static constexpr T bluestein_cost = 12.0;
+		static constexpr T fold_cost = 4.0;
+		// a Bluestein plan holds about five vectors of up to 4*count points
+		static constexpr size_t bluestein_limit = size_t(1) << 18;
+
+		// Length of the transforms behind dense_values(count): the largest power of two dividing
+		// count when folding the spectrum once per interleaved grid is cheaper than Bluestein on
+		// count, or when count is too long for a Bluestein plan.
+		size_t dense_grid(size_t count) const noexcept
+		{
+			const auto grid = count & (~count + 1);
+			return count > bluestein_limit || dense_cost(count, grid) < dense_cost(count, count) ? grid : count;
+		}
+
+		// f(start + 2*pi*m/count) for m < count, or f' with derivative set. With d_k the coefficient
+		// of e^(ik*angle), f is sum_k d_k*e^(ik*start) * e^(2*pi*i*k*m/count) and f' the same sum over
+		// ik*d_k; harmonics above count/2 fold onto k mod count.
+		// A count of p*2^j splits into p interleaved grids of 2^j points, one radix-2 transform each,
+		// so only counts without a large power-of-two factor go through a single Bluestein transform.
+		std::vector<complex_type> dense_values(T start_angle, size_t count, bool derivative = false) const
+		{
+			const auto length = dense_grid(count);
+			const auto stride = count / length;
+			const auto inverse = plan_for(length);
+
+			// d_k and d_-k, the coefficients of e^(ik*angle) and e^(-ik*angle)
+			std::vector<std::pair<complex_type, complex_type>> d;
+			d.reserve(ab.size());
+			for (const auto& c : ab)
+			{
+				const auto ib = complex_type(-c.second.imag(), c.second.real());
+				d.emplace_back((c.first - ib) * T(0.5), (c.first + ib) * T(0.5));
+				if (derivative)
+				{
+					const auto k = static_cast<T>(d.size());
+					d.back() = { d.back().first * complex_type(0, k), d.back().second * complex_type(0, -k) };
+				}
+			}
+
+			std::vector<complex_type> values(count);
+			std::vector<complex_type> spectrum(stride == 1 ? 0 : length);
+			auto& grid = stride == 1 ? values : spectrum;
+			for (size_t r = 0; r < stride; ++r)
+			{
+				const auto start = start_angle + 2 * pi * static_cast<T>(r) / static_cast<T>(count);
+				std::fill(grid.begin(), grid.end(), complex_type{});
+				grid[0] = derivative ? complex_type{} : a0;
+				TrigonometricIterator w(start);
+				// k and -k wrap around the grid in opposite directions
+				for (size_t k = 0, plus = 1 % length, minus = length - 1; k < d.size(); ++k, ++w)
+				{
+					// written out: operator* would check every product for inf/nan
+					const auto& p = d[k].first;
+					const auto& m = d[k].second;
+					grid[plus] += complex_type(w->real() * p.real() - w->imag() * p.imag(), w->real() * p.imag() + w->imag() * p.real());
+					grid[minus] += complex_type(w->real() * m.real() + w->imag() * m.imag(), w->real() * m.imag() - w->imag() * m.real());
+					plus = plus + 1 == length ? 0 : plus + 1;
+					minus = minus == 0 ? length - 1 : minus - 1;
+				}
+
+				inverse->inverse(grid.data());
+				if (stride != 1)
+					for (size_t s = 0; s < length; ++s)
+						values[r + s * stride] = grid[s];
+			}
+			return values;
+		}
+
+		// The fit's own plan when the length matches, else the one kept for the last other length;
+		// values() asks for the same period frame after frame, and a Bluestein plan of a long period
+		// is expensive to set up.
+		std::shared_ptr<const fft_plan> plan_for(size_t length) const
+		{
+			if (plan && plan->size() == length)
+				return plan;
+			std::lock_guard<std::mutex> lock(plan_mutex);
+			if (!other_plan || other_plan->size() != length)
+				other_plan = std::make_shared<const fft_plan>(length);
+			return other_plan;
+		}
+
+		void fit_samples(std::vector<complex_type>&& spectrum)
+		{
+			ab.clear();
+			square_value = -1.0; //reset;
+			size = spectrum.size();
+			is_odd = size % 2 != 0;
+			a0 = {};
+			sample_energy = 0.0;
+			if (!spectrum.empty())
+			{
+				if (!plan || plan->size() != size)
+					plan = std::make_shared<const fft_plan>(size);
+				plan->forward(spectrum.data());
+
+				assign_spectrum(spectrum, harmonics_within_limit(spectrum));
+			}
+			coeffs_changed();
+		}
+
+		// Harmonic k carries (|X_k|^2 + |X_(N-k)|^2) / N^2 of the mean sample energy, so the
+		// squared residual of keeping 1..M is the energy of the harmonics above M.
+		size_t harmonics_within_limit(const std::vector<complex_type>& spectrum)
+		{
+			const auto n2 = static_cast<T>(size) * static_cast<T>(size);
+			for (const auto& x : spectrum)
+				sample_energy += std::norm(x);
+			sample_energy /= n2;
+
+			size_t count = size / 2;
+			T dropped = 0.0;
+			const auto budget = rms_tolerance * rms_tolerance;
+			while (budget > 0.0 && count != 0)
+			{
+				const auto energy = (2 * count == size ? std::norm(spectrum[count]) : std::norm(spectrum[count]) + std::norm(spectrum[size - count])) / n2;
+				if (dropped + energy > budget)
+					break;
+				dropped += energy;
+				--count;
+			}
+			return std::min(count, harmonic_limit);
+		}
+
+		void assign_spectrum(const std::vector<complex_type>& spectrum, size_t harmonics)
+		{
+			a0 = spectrum_coeffs(spectrum, harmonics, ab);
+		}
+
+		// Appends harmonics 1..harmonics of the forward DFT of N = spectrum.size() samples to ab and
+		// returns a0. Sample j sits at angle (2j+1)*pi/N, so sum_j z_j*e^(+-ik*angle_j) = e^(+-ik*pi/N) * X_(-+k).
+		static complex_type spectrum_coeffs(const std::vector<complex_type>& spectrum, size_t harmonics, std::vector<TrCoeff>& ab)
+		{
+			const size_t size = spectrum.size();
+			const bool is_odd = size % 2 != 0;
+			const auto n = static_cast<T>(size);
+			const auto del = 2 / n;
+
+			const size_t count = std::min(harmonics, is_odd ? (size - 1) / 2 : size / 2 - 1);
+			ab.reserve(ab.size() + count + 1);
+			for (size_t k = 1; k <= count; ++k)
+			{
+				const auto w = make_sincos(static_cast<T>(k) * pi / n);
+				const auto plus = w * spectrum[size - k];
+				const auto minus = std::conj(w) * spectrum[k];
+				ab.emplace_back((plus + minus) * (del / 2), (plus - minus) * complex_type(0, -del / 2));
+			}
+
+			if (!is_odd && harmonics >= size / 2)
+				ab.emplace_back(complex_type{}, spectrum[size / 2] / n);
+			return spectrum[0] / n;
+		}
+
+		// the last entry of a full fit of an even sample count is the sin(N/2 * angle) term
+		bool has_nyquist() const noexcept
+		{
+			return !is_odd && size != 0 && ab.size() == size / 2;
+		}
+
+		complex_type a0;
 		std::vector<TrCoeff> ab;
+		detail::coeff_soa<T> soa;
+		std::vector<T> tail_bound{ 0.0 };
 		size_t size{};
 		bool is_odd = {};
-		mutable double square_value = -1.0;
+		mutable T square_value = -1.0;
+		T sample_energy = 0.0;
+		size_t harmonic_limit = all_harmonics;
+		T rms_tolerance = 0.0;
+		std::shared_ptr<const fft_plan> plan;
+		thread_pool* pool = nullptr;
+		mutable std::mutex cache_mutex;
+		mutable std::shared_ptr<const arc_table> arc;
+		mutable std::shared_ptr<const polyline_tree> tree;
+		// separate from cache_mutex: the cached tables are built with plans from plan_for
+		mutable std::mutex plan_mutex;
+		mutable std::shared_ptr<const fft_plan> other_plan;
 	};
+
+	using fourier = basic_fourier<double>;
 }